@@ -1,10 +1,51 @@
 #include <CMakeInitializer/Errors.h>
 #include <CMakeInitializer/CMakeInitializer.h>
+#include <CMakeInitializer/Watcher.h>
+#include <CMakeInitializer/AffectedTests.h>
+#include <CMakeInitializer/IncludeGraph.h>
+#include <CMakeInitializer/GeneratorBenchmark.h>
+#include <CMakeInitializer/LibraryGenerator.h>
+#include <cstring>
 #include <exception>
 #include <iostream>
 
+// Benchmark takes generator options too, so --bench may come anywhere among them
+static bool benchmark_requested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench") == 0 || std::strncmp(argv[i], "--bench=", 8) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int main(int argc, char* argv[]) {
     try {
+        if (argc > 1 && std::strcmp(argv[1], "watch") == 0) {
+            Watcher watcher = Watcher(argc - 1, argv + 1);
+            watcher.run();
+            return 0;
+        }
+        if (argc > 1 && std::strcmp(argv[1], "affected") == 0) {
+            AffectedTests affected = AffectedTests(argc - 1, argv + 1);
+            affected.run();
+            return 0;
+        }
+        if (argc > 1 && std::strcmp(argv[1], "include-graph") == 0) {
+            IncludeGraph graph = IncludeGraph(argc - 1, argv + 1);
+            graph.run();
+            return 0;
+        }
+        if (argc > 1 && std::strcmp(argv[1], "newlib") == 0) {
+            LibraryGenerator generator = LibraryGenerator(argc - 1, argv + 1);
+            generator.run();
+            return 0;
+        }
+        if (benchmark_requested(argc, argv)) {
+            GeneratorBenchmark benchmark = GeneratorBenchmark(argc, argv);
+            benchmark.run();
+            return 0;
+        }
         CMakeInitializer initializer = CMakeInitializer(argc, argv);
         initializer.initialize();
     } catch (ExitSignal &e) {
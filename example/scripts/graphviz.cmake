@@ -0,0 +1,28 @@
+# Dumps target dependency graph of build tree in working directory,
+# deps.svg and deps.png are rendered only when the dump differs from the last rendered one
+execute_process(COMMAND "${CMAKE_COMMAND}" "--graphviz=graphviz/deps.txt" .
+    OUTPUT_QUIET
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Dependency graph dump failed")
+endif()
+
+file(SHA256 graphviz/deps.txt hash)
+set(rendered "")
+if(EXISTS graphviz/deps.sha256 AND EXISTS deps.svg AND EXISTS deps.png)
+    file(READ graphviz/deps.sha256 rendered)
+endif()
+
+if(hash STREQUAL rendered)
+    message(STATUS "Dependency graph unchanged")
+else()
+    foreach(format svg png)
+        execute_process(COMMAND "${DOT}" -T${format} graphviz/deps.txt -o deps.${format}
+            RESULT_VARIABLE result)
+        if(NOT result EQUAL 0)
+            message(FATAL_ERROR "dot failed to render deps.${format}")
+        endif()
+    endforeach()
+    file(WRITE graphviz/deps.sha256 "${hash}")
+endif()
+file(TOUCH graphviz/deps.stamp)
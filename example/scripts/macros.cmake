@@ -19,18 +19,47 @@ macro(cmake_pm_add_tests)
     endif()
 endmacro()
 
+# Dependency graph is plotted outside of ALL (unless CMAKE_PM_GRAPHVIZ_ALL is ON) and only after CMakeLists or target set changed
+function(cmake_pm_write_target_set)
+    set(targets "")
+    set(directories "${PROJECT_SOURCE_DIR}")
+    while(directories)
+        list(POP_FRONT directories directory)
+        get_property(directory_targets DIRECTORY "${directory}" PROPERTY BUILDSYSTEM_TARGETS)
+        get_property(subdirectories DIRECTORY "${directory}" PROPERTY SUBDIRECTORIES)
+        list(APPEND targets ${directory_targets})
+        list(APPEND directories ${subdirectories})
+    endwhile()
+    list(SORT targets)
+    string(REPLACE ";" "\n" targets "${targets}")
+    # Rewritten only when content differs, so unchanged target set keeps graph up to date
+    file(CONFIGURE OUTPUT "${PROJECT_BINARY_DIR}/graphviz/targets.txt" CONTENT "${targets}\n")
+endfunction()
+
 macro(cmake_pm_add_graphviz)
     find_program(GRAPHVIZ dot)
     if(GRAPHVIZ)
-        add_custom_command(OUTPUT ${CMAKE_BINARY_DIR}/_graphviz
-            COMMAND ${CMAKE_COMMAND} "--graphviz=graphviz/deps.txt" .
-            COMMAND dot -Tsvg graphviz/deps.txt -o deps.svg
-            COMMAND dot -Tpng graphviz/deps.txt -o deps.png
+        option(CMAKE_PM_GRAPHVIZ_ALL "Plot dependency graph as part of ALL" OFF)
+        file(GLOB_RECURSE CMAKE_PM_GRAPHVIZ_INPUTS CONFIGURE_DEPENDS
+            "${PROJECT_SOURCE_DIR}/app/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/src/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/test/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/bench/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/scripts/*.cmake")
+        cmake_language(DEFER DIRECTORY "${PROJECT_SOURCE_DIR}" CALL cmake_pm_write_target_set)
+        add_custom_command(OUTPUT "${PROJECT_BINARY_DIR}/graphviz/deps.stamp"
+            COMMAND "${CMAKE_COMMAND}" "-DDOT=${GRAPHVIZ}" -P "${PROJECT_SOURCE_DIR}/scripts/graphviz.cmake"
+            DEPENDS
+                "${PROJECT_SOURCE_DIR}/CMakeLists.txt"
+                ${CMAKE_PM_GRAPHVIZ_INPUTS}
+                "${PROJECT_BINARY_DIR}/graphviz/targets.txt"
             COMMENT "Plotting dependencies graph to deps.svg"
-            DEPENDS "${CMAKE_PROJECT_NAME}-app"
-            WORKING_DIRECTORY "${CMAKE_BINARY_DIR}")
-        add_custom_target(graphviz ALL
-            DEPENDS ${CMAKE_BINARY_DIR}/_graphviz)
+            WORKING_DIRECTORY "${PROJECT_BINARY_DIR}")
+        if(CMAKE_PM_GRAPHVIZ_ALL)
+            add_custom_target(graphviz ALL DEPENDS "${PROJECT_BINARY_DIR}/graphviz/deps.stamp")
+        else()
+            add_custom_target(graphviz DEPENDS "${PROJECT_BINARY_DIR}/graphviz/deps.stamp")
+        endif()
     else()
         message(STATUS "GraphViz not found - dependency graph will not be generated")
     endif()
@@ -44,6 +73,157 @@ macro(cmake_pm_add_compile_commands)
     )
 endmacro()
 
+macro(cmake_pm_add_modules)
+    if(CMAKE_VERSION VERSION_LESS 3.28)
+        message(FATAL_ERROR "C++20 modules need CMake 3.28 or newer")
+    endif()
+    if(CMAKE_GENERATOR MATCHES "Ninja")
+        execute_process(COMMAND "${CMAKE_MAKE_PROGRAM}" --version
+            OUTPUT_VARIABLE CMAKE_PM_NINJA_VERSION
+            OUTPUT_STRIP_TRAILING_WHITESPACE)
+        if(CMAKE_PM_NINJA_VERSION VERSION_LESS 1.11)
+            message(FATAL_ERROR "C++20 modules need Ninja 1.11 or newer, found ${CMAKE_PM_NINJA_VERSION}")
+        endif()
+    elseif(NOT CMAKE_GENERATOR MATCHES "Visual Studio")
+        message(FATAL_ERROR "C++20 modules need Ninja or Visual Studio generator, not ${CMAKE_GENERATOR}")
+    endif()
+    if((CMAKE_CXX_COMPILER_ID STREQUAL "GNU" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 14)
+        OR (CMAKE_CXX_COMPILER_ID STREQUAL "Clang" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 16)
+        OR (CMAKE_CXX_COMPILER_ID STREQUAL "MSVC" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 19.34))
+        message(FATAL_ERROR "${CMAKE_CXX_COMPILER_ID} ${CMAKE_CXX_COMPILER_VERSION} can not scan C++20 modules")
+    endif()
+    set(CMAKE_CXX_SCAN_FOR_MODULES ON)
+endmacro()
+
+macro(cmake_pm_add_allocator ALLOCATOR)
+    set(CMAKE_PM_ALLOCATOR ${ALLOCATOR})
+    set(CMAKE_PM_ALLOCATOR_TARGET "")
+    if(CMAKE_PM_ALLOCATOR STREQUAL "mimalloc")
+        find_package(mimalloc 2.0 QUIET)
+        if(NOT mimalloc_FOUND)
+            CPMAddPackage(
+                NAME mimalloc
+                GITHUB_REPOSITORY microsoft/mimalloc
+                VERSION 2.1.7
+                OPTIONS "MI_BUILD_TESTS OFF" "MI_BUILD_STATIC OFF" "MI_BUILD_OBJECT OFF")
+        endif()
+        # Shared library interposes malloc and operator new of whole process
+        set(CMAKE_PM_ALLOCATOR_TARGET mimalloc)
+    elseif(CMAKE_PM_ALLOCATOR STREQUAL "jemalloc")
+        # jemalloc is built with autotools, so it is taken from the system
+        find_package(PkgConfig QUIET)
+        if(PkgConfig_FOUND)
+            pkg_check_modules(JEMALLOC QUIET IMPORTED_TARGET jemalloc)
+        endif()
+        if(JEMALLOC_FOUND)
+            set(CMAKE_PM_ALLOCATOR_TARGET PkgConfig::JEMALLOC)
+        else()
+            find_library(CMAKE_PM_JEMALLOC_LIBRARY jemalloc)
+            if(NOT CMAKE_PM_JEMALLOC_LIBRARY)
+                message(FATAL_ERROR "jemalloc not found - install it (libjemalloc-dev or jemalloc-devel) or choose other allocator")
+            endif()
+            set(CMAKE_PM_ALLOCATOR_TARGET ${CMAKE_PM_JEMALLOC_LIBRARY})
+        endif()
+    elseif(NOT CMAKE_PM_ALLOCATOR STREQUAL "system")
+        message(FATAL_ERROR "Unknown allocator ${CMAKE_PM_ALLOCATOR} - use system, mimalloc or jemalloc")
+    endif()
+    message(STATUS "Allocator: ${CMAKE_PM_ALLOCATOR}")
+endmacro()
+
+macro(cmake_pm_add_benchmarks)
+    if(EXISTS "${PROJECT_SOURCE_DIR}/bench/CMakeLists.txt")
+        add_subdirectory(bench EXCLUDE_FROM_ALL)
+    endif()
+    # Benchmarks of single libraries (bench/<lib>) join run_benchmarks on their own
+    file(GLOB CMAKE_PM_BENCH_DIRS LIST_DIRECTORIES true "${PROJECT_SOURCE_DIR}/bench/*")
+    foreach(CMAKE_PM_BENCH_DIR ${CMAKE_PM_BENCH_DIRS})
+        if(EXISTS "${CMAKE_PM_BENCH_DIR}/CMakeLists.txt")
+            add_subdirectory("${CMAKE_PM_BENCH_DIR}" EXCLUDE_FROM_ALL)
+        endif()
+    endforeach()
+endmacro()
+
+macro(cmake_pm_add_heap_profiler)
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux" AND EXISTS "${PROJECT_SOURCE_DIR}/tools/heapprof/CMakeLists.txt")
+        add_subdirectory(tools/heapprof EXCLUDE_FROM_ALL)
+    endif()
+endmacro()
+
+# Ninja job pools: compiles use every core, links are limited by memory available at configure time
+macro(cmake_pm_add_job_pools)
+    set(CMAKE_PM_LINK_JOB_MEMORY 4096 CACHE STRING "Memory reserved for one link job, MB")
+    cmake_host_system_information(RESULT CMAKE_PM_CORES QUERY NUMBER_OF_LOGICAL_CORES)
+    cmake_host_system_information(RESULT CMAKE_PM_AVAILABLE_MEMORY QUERY AVAILABLE_PHYSICAL_MEMORY)
+    math(EXPR CMAKE_PM_LINK_JOBS "${CMAKE_PM_AVAILABLE_MEMORY} / ${CMAKE_PM_LINK_JOB_MEMORY}")
+    if(CMAKE_PM_LINK_JOBS LESS 1)
+        set(CMAKE_PM_LINK_JOBS 1)
+    elseif(CMAKE_PM_LINK_JOBS GREATER CMAKE_PM_CORES)
+        set(CMAKE_PM_LINK_JOBS ${CMAKE_PM_CORES})
+    endif()
+    set_property(GLOBAL APPEND PROPERTY JOB_POOLS
+        cmake_pm_compile=${CMAKE_PM_CORES}
+        cmake_pm_link=${CMAKE_PM_LINK_JOBS})
+    set(CMAKE_JOB_POOL_COMPILE cmake_pm_compile)
+    set(CMAKE_JOB_POOL_LINK cmake_pm_link)
+    message(STATUS "Job pools: ${CMAKE_PM_CORES} compile, ${CMAKE_PM_LINK_JOBS} link (${CMAKE_PM_AVAILABLE_MEMORY} MB available)")
+endmacro()
+
+# Shared library exporting only symbols marked with <LIB>_EXPORT of generated <lib>/<lib>_export.h:
+# small dynamic symbol table, calls inside library bound directly instead of through PLT
+macro(cmake_pm_make_shared LIB)
+    include(GenerateExportHeader)
+    generate_export_header(${LIB} EXPORT_FILE_NAME "${PROJECT_BINARY_DIR}/include/${LIB}/${LIB}_export.h")
+    target_include_directories(${LIB} PUBLIC "${PROJECT_BINARY_DIR}/include")
+    set_target_properties(${LIB} PROPERTIES
+        C_VISIBILITY_PRESET hidden
+        CXX_VISIBILITY_PRESET hidden
+        VISIBILITY_INLINES_HIDDEN ON)
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+        target_link_options(${LIB} PUBLIC "LINKER:--as-needed")
+        target_link_options(${LIB} PRIVATE "LINKER:-Bsymbolic-functions")
+    endif()
+endmacro()
+
+# Absolute paths and timestamps do not leak into artifacts, so different checkouts produce identical objects
+# and share compiler cache entries
+macro(cmake_pm_add_reproducible_build)
+    if(CMAKE_C_COMPILER_ID MATCHES "GNU|Clang" AND CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        # The last matching map wins, build tree is usually inside source tree
+        add_compile_options(
+            "-ffile-prefix-map=${PROJECT_SOURCE_DIR}=."
+            "-fdebug-prefix-map=${PROJECT_SOURCE_DIR}=."
+            "-ffile-prefix-map=${PROJECT_BINARY_DIR}=build"
+            "-fdebug-prefix-map=${PROJECT_BINARY_DIR}=build")
+    endif()
+    if(NOT APPLE)
+        foreach(LANG C CXX)
+            set(CMAKE_${LANG}_ARCHIVE_CREATE "<CMAKE_AR> qcD <TARGET> <LINK_FLAGS> <OBJECTS>")
+            set(CMAKE_${LANG}_ARCHIVE_APPEND "<CMAKE_AR> qD <TARGET> <LINK_FLAGS> <OBJECTS>")
+            set(CMAKE_${LANG}_ARCHIVE_FINISH "<CMAKE_RANLIB> -D <TARGET>")
+        endforeach()
+    endif()
+    set(CMAKE_BUILD_RPATH_USE_ORIGIN ON)
+    find_program(CMAKE_PM_CCACHE ccache)
+    if(CMAKE_PM_CCACHE)
+        # Paths below source tree are hashed relative to it
+        foreach(LANG C CXX)
+            set(CMAKE_${LANG}_COMPILER_LAUNCHER
+                ${CMAKE_COMMAND} -E env "CCACHE_BASEDIR=${PROJECT_SOURCE_DIR}" CCACHE_NOHASHDIR=1 ${CMAKE_PM_CCACHE})
+        endforeach()
+    endif()
+endmacro()
+
+# Coverage build type: clang source-based coverage or gcov instrumentation of gcc
+macro(cmake_pm_add_coverage)
+    if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        set(CMAKE_PM_COVERAGE_FLAGS "-fprofile-instr-generate;-fcoverage-mapping")
+    elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        set(CMAKE_PM_COVERAGE_FLAGS "--coverage;-fprofile-update=atomic")
+    endif()
+    add_compile_options("$<$<CONFIG:Coverage>:-O0;-g;${CMAKE_PM_COVERAGE_FLAGS}>")
+    add_link_options("$<$<CONFIG:Coverage>:${CMAKE_PM_COVERAGE_FLAGS}>")
+endmacro()
+
 macro(cmake_pm_add_CPM)
     include(./scripts/CPM.cmake)
     set(CPM_SOURCE_CACHE ~/.cache/CPM)
@@ -1,5 +1,143 @@
 #include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Appends one JSON line per test to TEST_PERF_OUTPUT (test_perf.jsonl in test working directory):
+// wall and CPU time, growth of max RSS and, when perf_event_open is allowed, cycles and instructions.
+// Lines are written with single O_APPEND write, so tests run in parallel by ctest do not interleave.
+class PerformanceListener : public ::testing::EmptyTestEventListener {
+private:
+    int output = -1;
+    int cycles = -1;
+    int instructions = -1;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start = 0;
+    long max_rss_start = 0;
+
+    static double cpu_seconds() {
+        timespec now;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+    static long max_rss_kb() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    static std::string escaped(const char* text) {
+        std::string result;
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                result += '\\';
+            }
+            result += *text;
+        }
+        return result;
+    }
+
+#ifdef __linux__
+    static int open_counter(uint64_t config, int group) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = config;
+        attributes.disabled = group == -1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.inherit = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0));
+    }
+
+    static uint64_t read_counter(int counter) {
+        uint64_t value = 0;
+        return read(counter, &value, sizeof(value)) == sizeof(value) ? value : 0;
+    }
+#endif
+
+    static std::string counter_json(int counter) {
+#ifdef __linux__
+        if (counter >= 0) {
+            return std::to_string(read_counter(counter));
+        }
+#endif
+        return "null";
+    }
+public:
+    PerformanceListener() {
+        const char* path = std::getenv("TEST_PERF_OUTPUT");
+        output = open(path ? path : "test_perf.jsonl", O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#ifdef __linux__
+        cycles = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (cycles >= 0) {
+            instructions = open_counter(PERF_COUNT_HW_INSTRUCTIONS, cycles);
+        }
+#endif
+    }
+
+    ~PerformanceListener() override {
+        for (int descriptor : {output, cycles, instructions}) {
+            if (descriptor >= 0) {
+                close(descriptor);
+            }
+        }
+    }
+
+    void OnTestStart(const ::testing::TestInfo&) override {
+#ifdef __linux__
+        if (cycles >= 0) {
+            ioctl(cycles, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(cycles, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        max_rss_start = max_rss_kb();
+        cpu_start = cpu_seconds();
+        wall_start = std::chrono::steady_clock::now();
+    }
+
+    void OnTestEnd(const ::testing::TestInfo& info) override {
+        std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - wall_start;
+        double cpu_ms = (cpu_seconds() - cpu_start) * 1000;
+#ifdef __linux__
+        if (cycles >= 0) {
+            ioctl(cycles, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        if (output < 0) {
+            return;
+        }
+        const char* result = info.result()->Skipped() ? "skipped" : info.result()->Passed() ? "passed" : "failed";
+        std::string line = "{\"suite\":\"" + escaped(info.test_suite_name())
+            + "\",\"test\":\"" + escaped(info.name())
+            + "\",\"result\":\"" + result
+            + "\",\"wall_ms\":" + std::to_string(wall.count())
+            + ",\"cpu_ms\":" + std::to_string(cpu_ms)
+            + ",\"max_rss_delta_kb\":" + std::to_string(max_rss_kb() - max_rss_start)
+            + ",\"cycles\":" + counter_json(cycles)
+            + ",\"instructions\":" + counter_json(instructions) + "}\n";
+        if (write(output, line.data(), line.size()) < 0) {
+            close(output);
+            output = -1;
+        }
+    }
+};
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
+    ::testing::UnitTest::GetInstance()->listeners().Append(new PerformanceListener());
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,420 @@
+// Allocation profiler preloaded into app by cmake-pm run --heap (glibc, LD_PRELOAD).
+// Allocations are sampled every HEAPPROF_SAMPLE bytes (512 KiB by default) with their backtrace into thread-local
+// buffers, resident set size is sampled every HEAPPROF_INTERVAL ms (10 by default). At exit top HEAPPROF_TOP (20)
+// allocation sites are written to heapprof.<pid>.txt and RSS timeline to heapprof.<pid>.rss.csv in HEAPPROF_DIR.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+#define HEAPPROF_TLS __attribute__((tls_model("initial-exec"))) thread_local
+
+namespace {
+
+constexpr int max_frames = 24;
+constexpr size_t buffer_capacity = 512;
+constexpr size_t max_rss_samples = 1 << 14;
+
+struct Sample {
+    void* frames[max_frames];
+    int depth;
+    size_t size;
+};
+
+// Appended by its own thread, merged into sites by it when full and by exit handler; both hold the lock
+struct ThreadBuffer {
+    Sample samples[buffer_capacity];
+    size_t count = 0;
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    ThreadBuffer* next = nullptr;
+};
+
+class BufferLock {
+private:
+    ThreadBuffer& buffer;
+public:
+    explicit BufferLock(ThreadBuffer& buffer) : buffer(buffer) {
+        while (buffer.lock.test_and_set(std::memory_order_acquire)) {
+            sched_yield();
+        }
+    }
+    BufferLock(const BufferLock&) = delete;
+    BufferLock& operator=(const BufferLock&) = delete;
+    ~BufferLock() { buffer.lock.clear(std::memory_order_release); }
+};
+
+struct Site {
+    uint64_t samples = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+struct RssSample {
+    uint64_t ms;
+    uint64_t kb;
+};
+
+// Plain globals: allocations start before constructors run and continue after destructors
+int64_t sample_interval = 512 * 1024;
+std::atomic<ThreadBuffer*> buffers{nullptr};
+std::mutex sites_mutex;
+std::unordered_map<std::string, Site>* sites = nullptr;
+RssSample rss_samples[max_rss_samples];
+std::atomic<size_t> rss_count{0};
+// Sampler is joined at exit before timeline is read, running is guarded by sampler_mutex.
+// pthread types are used because they have no destructor to run at exit while sampler waits.
+pthread_mutex_t sampler_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t sampler_wake;
+bool running = false;
+bool sampler_started = false;
+pthread_t sampler;
+timespec start_time;
+// Executable segment of profiler: leading frames inside it are dropped, however compiler inlined hooks
+uintptr_t own_code_begin = 0;
+uintptr_t own_code_end = 0;
+
+// Allocations of the profiler itself (and of backtrace() loading unwinder) are not sampled
+HEAPPROF_TLS bool busy = false;
+HEAPPROF_TLS int64_t until_sample = 0;
+HEAPPROF_TLS ThreadBuffer* buffer = nullptr;
+
+uint64_t elapsed_ms() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start_time.tv_sec) * 1000 + (now.tv_nsec - start_time.tv_nsec) / 1000000;
+}
+
+uint64_t resident_kb() {
+    char text[128] = {};
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    unsigned long long size = 0, resident = 0;
+    if (length <= 0 || std::sscanf(text, "%llu %llu", &size, &resident) != 2) {
+        return 0;
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+bool own_code(void* frame) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(frame);
+    return address >= own_code_begin && address < own_code_end;
+}
+
+// Called for every loaded module, stops at the one whose executable segment holds this function
+int find_own_code(dl_phdr_info* info, size_t, void*) {
+    uintptr_t self = reinterpret_cast<uintptr_t>(&find_own_code);
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+        uintptr_t begin = info->dlpi_addr + segment.p_vaddr;
+        if (segment.p_type == PT_LOAD && (segment.p_flags & PF_X)
+                && self >= begin && self < begin + segment.p_memsz) {
+            own_code_begin = begin;
+            own_code_end = begin + segment.p_memsz;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Estimated allocations and bytes behind one sample: large allocations are sampled almost surely,
+// small ones stand for every allocation of their size in sampling interval. Caller holds lock of the buffer.
+void merge(ThreadBuffer& from) {
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    if (!sites) {
+        sites = new std::unordered_map<std::string, Site>();
+    }
+    for (size_t i = 0; i < from.count; ++i) {
+        const Sample& sample = from.samples[i];
+        int first = 0;
+        while (first < sample.depth && own_code(sample.frames[first])) {
+            ++first;
+        }
+        Site& site = (*sites)[std::string(reinterpret_cast<const char*>(sample.frames + first),
+            (sample.depth - first) * sizeof(void*))];
+        uint64_t size = std::max<uint64_t>(sample.size, 1);
+        site.samples += 1;
+        site.allocations += std::max<uint64_t>(1, sample_interval / size);
+        site.bytes += std::max<uint64_t>(size, sample_interval);
+    }
+    from.count = 0;
+}
+
+__attribute__((noinline)) void record(size_t size) {
+    if (busy) {
+        return;
+    }
+    busy = true;
+    if (!buffer) {
+        buffer = new (__libc_malloc(sizeof(ThreadBuffer))) ThreadBuffer();
+        buffer->next = buffers.load();
+        while (!buffers.compare_exchange_weak(buffer->next, buffer)) {
+        }
+    }
+    // Unwinding is done outside of the lock, exit handler does not wait for it
+    Sample sample;
+    sample.depth = backtrace(sample.frames, max_frames);
+    sample.size = size;
+    {
+        BufferLock lock(*buffer);
+        if (buffer->count == buffer_capacity) {
+            merge(*buffer);
+        }
+        buffer->samples[buffer->count] = sample;
+        ++buffer->count;
+    }
+    busy = false;
+}
+
+inline void allocated(size_t size) {
+    until_sample -= static_cast<int64_t>(size);
+    if (until_sample < 0) {
+        until_sample = sample_interval;
+        record(size);
+    }
+}
+
+// Timeline keeps every other sample when full, so long runs are covered with coarser resolution
+void* sample_rss(void* argument) {
+    busy = true;
+    uint64_t interval_ms = reinterpret_cast<uintptr_t>(argument);
+    pthread_mutex_lock(&sampler_mutex);
+    while (running) {
+        size_t count = rss_count.load();
+        if (count == max_rss_samples) {
+            for (size_t i = 0; i < max_rss_samples / 2; ++i) {
+                rss_samples[i] = rss_samples[2 * i];
+            }
+            count = max_rss_samples / 2;
+            interval_ms *= 2;
+        }
+        rss_samples[count] = {elapsed_ms(), resident_kb()};
+        rss_count.store(count + 1);
+        timespec wake;
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        wake.tv_sec += interval_ms / 1000;
+        wake.tv_nsec += interval_ms % 1000 * 1000000;
+        if (wake.tv_nsec >= 1000000000) {
+            wake.tv_sec += 1;
+            wake.tv_nsec -= 1000000000;
+        }
+        while (running && pthread_cond_timedwait(&sampler_wake, &sampler_mutex, &wake) == 0) {
+        }
+    }
+    pthread_mutex_unlock(&sampler_mutex);
+    return nullptr;
+}
+
+// Only the forking thread survives in child: profiler mutexes are taken around fork so that no lost thread
+// holds them, buffer locks of lost threads are released (their unfinished sample is not counted yet)
+// and child keeps profiling without the sampler
+void before_fork() {
+    pthread_mutex_lock(&sampler_mutex);
+    sites_mutex.lock();
+}
+
+void after_fork_parent() {
+    sites_mutex.unlock();
+    pthread_mutex_unlock(&sampler_mutex);
+}
+
+void after_fork_child() {
+    sites_mutex.unlock();
+    pthread_mutex_unlock(&sampler_mutex);
+    running = false;
+    sampler_started = false;
+    for (ThreadBuffer* thread = buffers.load(); thread; thread = thread->next) {
+        thread->lock.clear(std::memory_order_release);
+    }
+}
+
+std::string describe(void* frame) {
+    Dl_info info = {};
+    char text[64];
+    if (!dladdr(frame, &info) || !info.dli_fname) {
+        std::snprintf(text, sizeof(text), "%p", frame);
+        return text;
+    }
+    const char* module = std::strrchr(info.dli_fname, '/');
+    module = module ? module + 1 : info.dli_fname;
+    if (info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : info.dli_sname;
+        std::free(demangled);
+        std::snprintf(text, sizeof(text), "+0x%zx (", static_cast<size_t>(
+            static_cast<char*>(frame) - static_cast<char*>(info.dli_saddr)));
+        return name + text + module + ")";
+    }
+    // Offset in module, for addr2line -e <module> when symbols are not exported
+    std::snprintf(text, sizeof(text), "+0x%zx", static_cast<size_t>(
+        static_cast<char*>(frame) - static_cast<char*>(info.dli_fbase)));
+    return module + std::string(text);
+}
+
+__attribute__((constructor)) void start() {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    dl_iterate_phdr(find_own_code, nullptr);
+    if (const char* sample = std::getenv("HEAPPROF_SAMPLE")) {
+        sample_interval = std::max(1LL, std::atoll(sample));
+    }
+    // Programs started by app are not profiled
+    unsetenv("LD_PRELOAD");
+    const char* interval = std::getenv("HEAPPROF_INTERVAL");
+    uintptr_t interval_ms = interval ? std::max(1LL, std::atoll(interval)) : 10;
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&sampler_wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    running = true;
+    sampler_started = pthread_create(&sampler, nullptr, sample_rss, reinterpret_cast<void*>(interval_ms)) == 0;
+    pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+}
+
+__attribute__((destructor)) void finish() {
+    busy = true;
+    if (sampler_started) {
+        pthread_mutex_lock(&sampler_mutex);
+        running = false;
+        pthread_cond_signal(&sampler_wake);
+        pthread_mutex_unlock(&sampler_mutex);
+        pthread_join(sampler, nullptr);
+        sampler_started = false;
+    }
+    size_t count = rss_count.load();
+    if (count < max_rss_samples) {
+        rss_samples[count] = {elapsed_ms(), resident_kb()};
+        rss_count.store(++count);
+    }
+    for (ThreadBuffer* thread = buffers.load(); thread; thread = thread->next) {
+        BufferLock lock(*thread);
+        merge(*thread);
+    }
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    std::vector<std::pair<std::string, Site>> ranked;
+    uint64_t total_bytes = 0, total_allocations = 0;
+    if (sites) {
+        for (const auto& site : *sites) {
+            ranked.push_back(site);
+            total_bytes += site.second.bytes;
+            total_allocations += site.second.allocations;
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) {
+        return left.second.bytes > right.second.bytes;
+    });
+    const char* top = std::getenv("HEAPPROF_TOP");
+    ranked.resize(std::min<size_t>(ranked.size(), top ? std::max(1, std::atoi(top)) : 20));
+    RssSample peak = {0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        if (rss_samples[i].kb > peak.kb) {
+            peak = rss_samples[i];
+        }
+    }
+
+    const char* directory = std::getenv("HEAPPROF_DIR");
+    std::string prefix = std::string(directory ? directory : ".") + "/heapprof." + std::to_string(getpid());
+    if (FILE* timeline = std::fopen((prefix + ".rss.csv").c_str(), "w")) {
+        std::fprintf(timeline, "ms,rss_kb\n");
+        for (size_t i = 0; i < count; ++i) {
+            std::fprintf(timeline, "%llu,%llu\n",
+                static_cast<unsigned long long>(rss_samples[i].ms), static_cast<unsigned long long>(rss_samples[i].kb));
+        }
+        std::fclose(timeline);
+    }
+    FILE* report = std::fopen((prefix + ".txt").c_str(), "w");
+    if (!report) {
+        return;
+    }
+    std::fprintf(report, "Estimated %llu allocations, %.1f MiB (sampled every %lld bytes)\n",
+        static_cast<unsigned long long>(total_allocations), total_bytes / 1048576.0,
+        static_cast<long long>(sample_interval));
+    std::fprintf(report, "Peak RSS %.1f MiB at %.3f s, timeline in %s.rss.csv\n",
+        peak.kb / 1024.0, peak.ms / 1000.0, prefix.c_str());
+    std::fprintf(report, "Frames without exported symbol are module+offset: addr2line -f -C -e <module> <offset>\n\n");
+    for (size_t rank = 0; rank < ranked.size(); ++rank) {
+        const Site& site = ranked[rank].second;
+        std::fprintf(report, "#%zu %.1f MiB (%.1f%%), %llu allocations, %llu samples\n", rank + 1,
+            site.bytes / 1048576.0, total_bytes ? 100.0 * site.bytes / total_bytes : 0.0,
+            static_cast<unsigned long long>(site.allocations), static_cast<unsigned long long>(site.samples));
+        const std::string& stack = ranked[rank].first;
+        for (size_t frame = 0; frame < stack.size() / sizeof(void*); ++frame) {
+            void* address;
+            std::memcpy(&address, stack.data() + frame * sizeof(void*), sizeof(void*));
+            std::fprintf(report, "    %s\n", describe(address).c_str());
+        }
+        std::fprintf(report, "\n");
+    }
+    std::fclose(report);
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    allocated(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    size_t total = 0;
+    // Overflowing request fails in libc, nothing is allocated
+    if (!__builtin_mul_overflow(count, size, &total)) {
+        allocated(total);
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    allocated(size);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    allocated(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    allocated(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    allocated(size);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : ENOMEM;
+}
+
+}
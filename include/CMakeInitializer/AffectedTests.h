@@ -0,0 +1,23 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class AffectedTests {
+private:
+    std::filesystem::path project_dir;
+    std::filesystem::path build_dir;
+    std::string git_ref;
+
+    std::filesystem::path dependency_dump() const;
+    std::map<std::string, std::set<std::string>> load_dependents() const;
+    std::vector<std::filesystem::path> changed_files() const;
+public:
+    AffectedTests(int argc, char* argv[]);
+    AffectedTests(const std::filesystem::path& project_dir, const std::filesystem::path& build_dir);
+    // Returns ctest regex selecting tests affected by changed files (relative to project), empty if none are
+    std::string test_filter(const std::vector<std::filesystem::path>& changed_files) const;
+    void run();
+};
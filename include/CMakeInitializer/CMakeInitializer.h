@@ -1,24 +1,83 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <string>
+#include <vector>
 
 class CMakeInitializer {
+public:
+    // Time spent in generation phases and size of generated project
+    struct Statistics {
+        std::chrono::nanoseconds directories{0};
+        std::chrono::nanoseconds rendering{0};
+        std::chrono::nanoseconds writes{0};
+        size_t files = 0;
+        uintmax_t bytes = 0;
+    };
 private:
+    enum class FileKind {
+        Managed,    // build infrastructure, refreshed by --update
+        Scaffold    // starting point edited by user, --update only creates it if missing
+    };
+    struct GeneratedFile {
+        std::string path;
+        std::string content;
+        FileKind kind;
+        bool executable;
+    };
+    using Files = std::vector<GeneratedFile>;
+    enum class UpdateAction { Created, Updated, Unchanged, Kept };
+
     std::string cmake_version;
     std::string project_name;
     std::string language;
     std::string file_extension;
     int standard;
+    bool modules;
+    bool tracing;
+    std::string allocator;
+    bool multi_config;
+    bool shared;
+    size_t synthetic_libs = 0;
+    size_t synthetic_files = 0;
+    size_t synthetic_deps = 0;
+    std::string template_pack;
+    bool update;
+    std::string output_archive;
+    bool zstd;
+    bool quiet;
+    size_t jobs;
+    Statistics stats;
+    std::filesystem::path project_dir;
+    std::vector<std::string> directories;
+    Files files;
 
+    std::string root_features() const;
+    static void add_file(Files& output, const std::string& path, const std::string& content,
+        FileKind kind = FileKind::Managed, bool executable = false);
+    void merge_files(std::vector<Files>& outputs);
+    void write_file(const GeneratedFile& file) const;
+    UpdateAction update_file(const GeneratedFile& file) const;
+    void report_update(const std::vector<UpdateAction>& actions) const;
+    void write_archive();
     void create_folder_structure();
-    void populate_root_folder();
-    void populate_app_folder();
-    void populate_include_folder();
-    void populate_src_folder();
-    void populate_docs_folder();
-    void populate_test_folder();
-    void populate_scripts_folder();
+    void populate_root_folder(Files& output) const;
+    void populate_app_folder(Files& output) const;
+    void populate_include_folder(Files& output) const;
+    void populate_src_folder(Files& output) const;
+    void populate_docs_folder(Files& output) const;
+    void populate_test_folder(Files& output) const;
+    void populate_bench_folder(Files& output) const;
+    void populate_tools_folder(Files& output) const;
+    std::string synthetic_library_name(size_t library) const;
+    std::vector<std::vector<size_t>> synthetic_dependencies() const;
+    void populate_synthetic_library(size_t library, const std::vector<size_t>& dependencies, Files& output) const;
+    void populate_scripts_folder(Files& output) const;
+    void populate_from_template_pack(Files& output) const;
 public:
     CMakeInitializer(int arcg, char* argv[]);
     void initialize();
+    const Statistics& statistics() const;
 };
 
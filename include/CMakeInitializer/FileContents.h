@@ -21,7 +21,10 @@ set(CMAKE_EXPORT_COMPILE_COMMANDS ON)
 set_property(GLOBAL PROPERTY USE_FOLDERS ON)
 
 cmake_pm_add_CPM()
-
+cmake_pm_add_job_pools()
+cmake_pm_add_reproducible_build()
+cmake_pm_add_coverage()
+%5%
 set(LIBRARY_LIST "")
 
 add_subdirectory(src)
@@ -29,6 +32,8 @@ add_subdirectory(src)
 if(PROJECT_IS_TOP_LEVEL)
     add_subdirectory(app)
     cmake_pm_add_tests()
+    cmake_pm_add_benchmarks()
+    cmake_pm_add_heap_profiler()
     # cmake_pm_add_docs()
     # cmake_pm_add_graphviz()
     cmake_pm_add_compile_commands()
@@ -37,70 +42,256 @@ endif()
 
 const char* const manager_file = R""""(#!/bin/bash
 project_name=%1%
+multi_config=%2%
+library_type=%3%
+cmake_init=${CMAKE_INIT:-cmake-init}
 parent_path=$( cd "$(dirname "${BASH_SOURCE[0]}")" ; pwd -P )
 cd "$parent_path";
+# Timestamps embedded by compiler (__DATE__, __TIME__) and tools follow last commit instead of build time
+export SOURCE_DATE_EPOCH=${SOURCE_DATE_EPOCH:-$(git log -1 --format=%%ct 2> /dev/null || echo 0)}
+
+# Build configuration of profile from "configuration" of its build preset (cmake-init watch reads it the same way),
+# presets without one are expected to be named after their configuration
+config_of() {
+    local config
+    config=$(cat CMakePresets.json CMakeUserPresets.json 2> /dev/null | tr -d ' \t\n' | tr '}' '\n' \
+        | grep "\"name\":\"${1}\"" | grep -o '"configuration":"[^"]*"' | head -1 | cut -d '"' -f 4)
+    echo "${config:-${1}}"
+}
+
+# Multi-config project shares one build tree between all profiles
+build_dir() {
+    if [[ "${multi_config}" == "true" ]]
+    then
+        echo './.build'
+    else
+        echo "./.build/${1}"
+    fi;
+}
+
+heapprof_path() {
+    if [[ "${multi_config}" == "true" ]]
+    then
+        echo "./.build/tools/heapprof/$(config_of "${1}")/libheapprof.so"
+    else
+        echo "./.build/${1}/tools/heapprof/libheapprof.so"
+    fi;
+}
+
+app_path() {
+    if [[ "${multi_config}" == "true" ]]
+    then
+        echo "./.build/app/$(config_of "${1}")/${project_name}-app"
+    else
+        echo "./.build/${1}/app/${project_name}-app"
+    fi;
+}
+
+if [[ "${1,,}" == "build" ]] && [[ "${2}" == "--verify-reproducible" ]]
+then
+    profile=${3:-release}
+    trees=.build/reproducible
+    rm -rf ${trees}
+    # Second checkout is a copy of sources at another absolute path, each is built in the same place inside it,
+    # so prefix maps must hide the difference. Without ccache objects of both trees are really compiled.
+    mkdir -p ${trees}/checkout
+    tar --exclude=./.build --exclude=./.git -cf - . | tar -xf - -C ${trees}/checkout
+    for checkout in . ${trees}/checkout
+    do
+        (cd "${checkout}" && export CCACHE_DISABLE=1 \
+            && cmake --preset "${profile}" -B ${trees}/build > /dev/null \
+            && cmake --build ${trees}/build --config "$(config_of "${profile}")" > /dev/null) || exit
+    done;
+    first=${trees}/build
+    second=${trees}/checkout/${trees}/build
+    compared=0
+    differences=0
+    while IFS= read -r artifact
+    do
+        compared=$((compared + 1))
+        if ! cmp -s "${first}/${artifact}" "${second}/${artifact}"
+        then
+            echo "Differs: ${artifact}"
+            differences=$((differences + 1))
+        fi;
+    done < <(cd ${first} && find . -type f \( -name '*.o' -o -name '*.a' -o -name '*.so' -o -name '*.so.*' -o -perm -u+x \) -not -path './CMakeFiles/*' | sort)
+    if [[ ${differences} -ne 0 ]]
+    then
+        echo "${differences} of ${compared} artifacts are not reproducible"
+        exit 1
+    fi;
+    echo "All ${compared} artifacts are reproducible"
+    exit
+fi;
 
 if [[ "${1,,}" == "build" ]]
 then
-    if [[ "${2,,}" == "release" ]] || [[ "${2,,}" == "debug" ]]
+    if [[ "${2}" == "--config" ]]
+    then
+        set -- "${1}" "${@:3}"
+    fi;
+    if [[ -z "${2}" ]]
     then
-        cmake -B ./.build/${2,,} -DCMAKE_BUILD_TYPE=${2^^} -G Ninja && cmake --build ./.build/${2,,}
+        echo 'Build needs profile, available profiles:'
+        cmake --list-presets
+        exit
+    fi;
+    if [[ "${multi_config}" == "true" ]]
+    then
+        # Configure is shared and every requested configuration is built by one Ninja invocation
+        targets=()
+        for profile in "${@:2}"
+        do
+            targets+=("all:$(config_of "${profile}")")
+        done;
+        cmake --preset "${2}" && cmake --build ./.build --target "${targets[@]}"
     else
-        echo 'Build avalable only in release and debug mode'
+        for profile in "${@:2}"
+        do
+            cmake --preset "${profile}" && cmake --build --preset "${profile}" || exit
+        done;
     fi;
     exit
 fi;
 
 if [[ "${1,,}" == "run" ]]
 then
-    if [[ "${2,,}" == "release" ]] || [[ "${2,,}" == "debug" ]]
+    heap=false
+    if [[ "${2}" == "--heap" ]]
+    then
+        heap=true
+        set -- "${1}" "${@:3}"
+    fi;
+    if [[ "${2}" == "--config" ]]
+    then
+        set -- "${1}" "${@:3}"
+    fi;
+    if [[ -n "${2}" ]] && [[ "${heap}" == "true" ]]
     then
-        cmake -B ./.build/${2,,} -DCMAKE_BUILD_TYPE=${2^^} -G Ninja && cmake --build ./.build/${2,,} && ./.build/${2,,}/app/${project_name}-app "${@:3}"
+        cmake --preset "${2}" && cmake --build --preset "${2}" --target all heapprof || exit
+        report_dir="$(build_dir "${2}")/heapprof"
+        mkdir -p "${report_dir}"
+        HEAPPROF_DIR="${report_dir}" LD_PRELOAD="${parent_path}/$(heapprof_path "${2}")" "$(app_path "${2}")" "${@:3}"
+        status=$?
+        cat "$(ls -t "${report_dir}"/heapprof.*.txt | head -n 1)"
+        exit ${status}
+    elif [[ -n "${2}" ]]
+    then
+        cmake --preset "${2}" && cmake --build --preset "${2}" && "$(app_path "${2}")" "${@:3}"
     else
-        echo 'Run avalable only in release and debug mode'
+        echo 'Run needs profile, available profiles:'
+        cmake --list-presets
     fi;
     exit
 fi;
 
 if [[ "${1,,}" == "newlib" ]]
 then
-    if [ -d ./include/${2} ] || [ -d ./src/${2} ]
+    exec ${cmake_init} newlib "$parent_path" --library-type "${library_type}" "${@:2}"
+fi;
+
+if [[ "${1,,}" == "docs" ]]
+then
+    cmake --preset debug && cmake --build --preset debug --target docs
+    exit
+fi;
+
+if [[ "${1,,}" == "test" ]] && [[ "${2}" == "--affected" ]]
+then
+    cmake --preset debug && cmake --build --preset debug --target tests || exit
+    tests=$(${cmake_init} affected --dir . --build "$(build_dir debug)" "${3:-HEAD}") || exit
+    if [[ -z "$tests" ]]
     then
-        echo 'Include or src directories already have similarly named library, aborting'
+        echo 'No tests affected by changes'
         exit
     fi;
-    mkdir ./include/${2}
-    echo '#pragma once' >> ./include/${2}/${2}.h
-    echo '' >> ./include/${2}/${2}.h
-    echo 'int sum(int a, int b);' >> ./include/${2}/${2}.h
-    mkdir ./src/${2}
-    echo "#include <${2}/${2}.h>" >> ./src/${2}/${2}%2%
-    echo '' >> ./src/${2}/${2}%2%
-    echo 'int sum(int a, int b){ return a + b; }' >> ./src/${2}/${2}%2%
-    echo "set(LIB_NAME ${2})" >> ./src/${2}/CMakeLists.txt
-    echo 'file(GLOB_RECURSE HEADER_FILES "${PROJECT_SOURCE_DIR}/include/${LIB_NAME}/*.h")' >> ./src/${2}/CMakeLists.txt
-    echo 'file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*%2%")' >> ./src/${2}/CMakeLists.txt
-    echo 'add_library(${LIB_NAME} ${SOURCE_FILES} ${HEADER_FILES})' >> ./src/${2}/CMakeLists.txt
-    echo 'target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")' >> ./src/${2}/CMakeLists.txt
-    echo 'set_target_properties(${LIB_NAME} PROPERTIES LINKER_LANGUAGE ${PROJECT_LANGUAGE})' >> ./src/${2}/CMakeLists.txt
-    echo 'list(APPEND LIBRARY_LIST ${LIB_NAME})' >> ./src/${2}/CMakeLists.txt
-    echo 'set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)' >> ./src/${2}/CMakeLists.txt
-    echo "Generated new library ${2}"
+    rm -f "$(build_dir debug)/test/test_perf.jsonl"
+    GTEST_COLOR=1 ctest --test-dir "$(build_dir debug)" -C Debug -R "$tests" "${@:4}"
     exit
 fi;
 
-if [[ "${1,,}" == "docs" ]]
+if [[ "${1,,}" == "test" ]]
 then
-    cmake -B ./.build/debug -DCMAKE_BUILD_TYPE=DEBUG -G Ninja && cmake --build ./.build/debug --target docs
+    cmake --preset debug && cmake --build --preset debug --target tests || exit
+    # Per-test performance log is rewritten by every run
+    rm -f "$(build_dir debug)/test/test_perf.jsonl"
+    GTEST_COLOR=1 ctest --test-dir "$(build_dir debug)" -C Debug "${@:2}"
     exit
 fi;
 
-if [[ "${1,,}" == "test" ]]
+if [[ "${1,,}" == "coverage" ]]
 then
-    cmake -B ./.build/debug -DCMAKE_BUILD_TYPE=DEBUG -G Ninja && cmake --build ./.build/debug --target test_exec && GTEST_COLOR=1 ctest --test-dir ./.build/debug "${@:2}"
+    tree=$(build_dir coverage)
+    report=${tree}/coverage
+    cmake --preset coverage && cmake --build --preset coverage --target tests || exit
+    rm -rf "${report}"
+    mkdir -p "${report}/html"
+    find "${tree}" -name '*.gcda' -delete
+    # Every test process writes its own profile (clang), gcov counters are merged under file lock (gcc): tests run in parallel
+    LLVM_PROFILE_FILE="${parent_path}/${report}/profiles/%%p.profraw" ctest --test-dir "${tree}" -C Coverage -j "$(nproc)" "${@:2}"
+    if compgen -G "${report}/profiles/*.profraw" > /dev/null
+    then
+        search=("${tree}/test")
+        if [[ "${multi_config}" == "true" ]]
+        then
+            # Shared tree holds test binaries of every profile, only coverage ones are instrumented
+            search+=(-path "*/$(config_of coverage)/*")
+        fi;
+        objects=()
+        while IFS= read -r binary
+        do
+            objects+=(${objects:+-object} "${binary}")
+        done < <(find "${search[@]}" -type f -perm -u+x \( -name '*_test' -o -name 'test_exec' \))
+        ignored='(^|/)(test|_deps|\.build)/|^/usr/'
+        llvm-profdata merge -sparse -num-threads="$(nproc)" "${report}"/profiles/*.profraw -o "${report}/coverage.profdata" || exit
+        llvm-cov show -format=html -output-dir="${report}/html" -num-threads="$(nproc)" -instr-profile="${report}/coverage.profdata" \
+            -ignore-filename-regex="${ignored}" "${objects[@]}" || exit
+        llvm-cov report -instr-profile="${report}/coverage.profdata" -ignore-filename-regex="${ignored}" "${objects[@]}"
+    elif command -v gcovr > /dev/null
+    then
+        gcovr --root . --object-directory "${tree}" -j "$(nproc)" --filter 'src/' --filter 'include/' \
+            --html-details "${report}/html/index.html" --print-summary
+    else
+        echo 'gcovr not found - install it (pip install gcovr) to process GCC coverage'
+        exit 1
+    fi;
+    echo "Coverage report: ${report}/html/index.html"
     exit
 fi;
 
+if [[ "${1,,}" == "bench" ]]
+then
+    cmake --preset release && cmake --build --preset release --target run_benchmarks
+    exit
+fi;
+
+if [[ "${1,,}" == "startup" ]]
+then
+    profile=${2:-release}
+    cmake --preset "${profile}" && cmake --build --preset "${profile}" || exit
+    # Dynamic loader reports relocations it processed and time spent before main
+    LD_DEBUG=statistics "$(app_path "${profile}")" "${@:3}" 2>&1 > /dev/null | grep -E 'startup time|relocations'
+    exit
+fi;
+
+if [[ "${1,,}" == "graph" ]]
+then
+    cmake --preset debug && cmake --build --preset debug --target graphviz || exit
+    echo "Dependency graph: $(build_dir debug)/deps.svg"
+    exit
+fi;
+
+if [[ "${1,,}" == "include-graph" ]]
+then
+    cmake --preset debug > /dev/null && exec ${cmake_init} include-graph --dir . "${@:2}"
+    exit
+fi;
+
+if [[ "${1,,}" == "watch" ]]
+then
+    exec ${cmake_init} watch --dir "$parent_path" "${@:2}"
+fi;
+
 if [[ "${1,,}" == "clear" ]]
 then
     rm -rf ./.build
@@ -109,17 +300,188 @@ then
 fi;
 
 echo 'Project manager program:'
-echo '    newlib {lib_name}     - create new project library with name lib_name'
-echo '    run {release/debug}   - run project in release/debug mode'
-echo '    build {release/debug} - build project in release/debug mode'
-echo '    docs                  - build docs (will be located in build/debug/docs directory)'
+echo '    newlib {lib_name...}  - create new project libraries with tests (--shared or --static, --modules for module interface units, --multiarch for x86-64 level dispatch)'
+echo '    run {profile}         - run project built with profile (debug, release, perf, minsize or own preset)'
+echo '    run --heap {profile}  - run project with heap profiler, report top allocation sites and peak RSS timeline'
+echo '    build {profile...}    - build project with profiles, all at once in multi-config project (--config optional)'
+echo '    build --verify-reproducible [profile] - build project and its copy at another path, compare artifacts'
+echo '    docs                  - build docs (will be located in .build/debug/docs directory)'
 echo '    test                  - run tests (you can provide same arguments as if you were calling ctest)'
+echo '    test --affected [ref] - run only tests affected by changes since git ref (HEAD by default)'
+echo '    coverage              - run tests in parallel with coverage instrumentation, write HTML report and summary'
+echo '    bench                 - build and run benchmarks from bench directory in release mode'
+echo '    startup [profile]     - show dynamic loader relocations and startup time of app (LD_DEBUG=statistics)'
+echo '    graph                 - plot target dependency graph (needs cmake_pm_add_graphviz() in CMakeLists.txt)'
+echo '    include-graph         - list headers costing most to parse, without compiling'
+echo '    watch [-m mode] [-t]  - rebuild on changes and rerun app (or tests with -t)'
 echo '    clear                 - clear build directory'
 )"""";
 
 const char* const gitignore_file = R""""(/.build
 /.cache
 compile_commands.json
+CMakeUserPresets.json
+)"""";
+
+// Every profile is configured into its own .build/<profile> tree, own presets belong to CMakeUserPresets.json
+const char* const presets_file = R""""({
+    "version": 3,
+    "cmakeMinimumRequired": {
+        "major": 3,
+        "minor": 21,
+        "patch": 0
+    },
+    "configurePresets": [
+        {
+            "name": "base",
+            "hidden": true,
+            "generator": "Ninja",
+            "binaryDir": "${sourceDir}/.build/${presetName}"
+        },
+        {
+            "name": "debug",
+            "displayName": "Debug",
+            "inherits": "base",
+            "cacheVariables": {
+                "CMAKE_BUILD_TYPE": "Debug"
+            }
+        },
+        {
+            "name": "release",
+            "displayName": "Release",
+            "inherits": "base",
+            "cacheVariables": {
+                "CMAKE_BUILD_TYPE": "Release"
+            }
+        },
+        {
+            "name": "perf",
+            "displayName": "Release for profiling (native ISA, frame pointers, debug info)",
+            "inherits": "base",
+            "cacheVariables": {
+                "CMAKE_BUILD_TYPE": "Perf",
+                "CMAKE_C_FLAGS_PERF": "-O3 -DNDEBUG -march=native -fno-omit-frame-pointer -g",
+                "CMAKE_CXX_FLAGS_PERF": "-O3 -DNDEBUG -march=native -fno-omit-frame-pointer -g"
+            }
+        },
+        {
+            "name": "minsize",
+            "displayName": "Release optimized for size",
+            "inherits": "base",
+            "cacheVariables": {
+                "CMAKE_BUILD_TYPE": "MinSizeRel"
+            }
+        },
+        {
+            "name": "coverage",
+            "displayName": "Debug with coverage instrumentation",
+            "inherits": "base",
+            "cacheVariables": {
+                "CMAKE_BUILD_TYPE": "Coverage"
+            }
+        }
+    ],
+    "buildPresets": [
+        {
+            "name": "debug",
+            "configurePreset": "debug"
+        },
+        {
+            "name": "release",
+            "configurePreset": "release"
+        },
+        {
+            "name": "perf",
+            "configurePreset": "perf"
+        },
+        {
+            "name": "minsize",
+            "configurePreset": "minsize"
+        },
+        {
+            "name": "coverage",
+            "configurePreset": "coverage"
+        }
+    ]
+}
+)"""";
+
+// Profiles are configurations of one Ninja Multi-Config tree in .build, configured once for all of them
+const char* const presets_multi_config_file = R""""({
+    "version": 3,
+    "cmakeMinimumRequired": {
+        "major": 3,
+        "minor": 21,
+        "patch": 0
+    },
+    "configurePresets": [
+        {
+            "name": "base",
+            "hidden": true,
+            "generator": "Ninja Multi-Config",
+            "binaryDir": "${sourceDir}/.build",
+            "cacheVariables": {
+                "CMAKE_CONFIGURATION_TYPES": "Debug;Release;Perf;MinSizeRel;Coverage",
+                "CMAKE_DEFAULT_BUILD_TYPE": "Debug",
+                "CMAKE_CROSS_CONFIGS": "all",
+                "CMAKE_C_FLAGS_PERF": "-O3 -DNDEBUG -march=native -fno-omit-frame-pointer -g",
+                "CMAKE_CXX_FLAGS_PERF": "-O3 -DNDEBUG -march=native -fno-omit-frame-pointer -g"
+            }
+        },
+        {
+            "name": "debug",
+            "displayName": "Debug",
+            "inherits": "base"
+        },
+        {
+            "name": "release",
+            "displayName": "Release",
+            "inherits": "base"
+        },
+        {
+            "name": "perf",
+            "displayName": "Release for profiling (native ISA, frame pointers, debug info)",
+            "inherits": "base"
+        },
+        {
+            "name": "minsize",
+            "displayName": "Release optimized for size",
+            "inherits": "base"
+        },
+        {
+            "name": "coverage",
+            "displayName": "Debug with coverage instrumentation",
+            "inherits": "base"
+        }
+    ],
+    "buildPresets": [
+        {
+            "name": "debug",
+            "configurePreset": "debug",
+            "configuration": "Debug"
+        },
+        {
+            "name": "release",
+            "configurePreset": "release",
+            "configuration": "Release"
+        },
+        {
+            "name": "perf",
+            "configurePreset": "perf",
+            "configuration": "Perf"
+        },
+        {
+            "name": "minsize",
+            "configurePreset": "minsize",
+            "configuration": "MinSizeRel"
+        },
+        {
+            "name": "coverage",
+            "configurePreset": "coverage",
+            "configuration": "Coverage"
+        }
+    ]
+}
 )"""";
 
 }
@@ -142,13 +504,40 @@ int main(int argc, char* argv[]) {
 }
 )"""";
 
+const char* const cpp_modules_file = R""""(#include <iostream>
+import example_lib;
+
+int main(int argc, char* argv[]) {
+    std::cout << sum(10, 20) << std::endl;
+}
+)"""";
+
+const char* const cpp_tracing_file = R""""(#include <iostream>
+#include <example_lib/example_lib.h>
+#include <tracing/tracing.h>
+
+int main(int argc, char* argv[]) {
+    TRACE_FUNCTION();
+    int result = 0;
+    {
+        TRACE_ZONE("sum");
+        result = sum(10, 20);
+    }
+    std::cout << result << std::endl;
+}
+)"""";
+
 const char* const cmake_file = R""""(add_executable("${CMAKE_PROJECT_NAME}-app" app%1%)
 set(GENERAL_COMPILE_FLAGS "-Wall;-Wextra")
 set(DEBUG_COMPILE_FLAGS "${GENERAL_COMPILE_FLAGS};-g;-O0")
 set(RELEASE_COMPILE_FLAGS "${GENERAL_COMPILE_FLAGS};-O3")
+set(PERF_COMPILE_FLAGS "${GENERAL_COMPILE_FLAGS};-O3;-march=native;-fno-omit-frame-pointer;-g")
+set(MINSIZE_COMPILE_FLAGS "${GENERAL_COMPILE_FLAGS};-Os")
 target_compile_options("${CMAKE_PROJECT_NAME}-app" PRIVATE "$<$<CONFIG:DEBUG>:${DEBUG_COMPILE_FLAGS}>")
 target_compile_options("${CMAKE_PROJECT_NAME}-app" PRIVATE "$<$<CONFIG:RELEASE>:${RELEASE_COMPILE_FLAGS}>")
-target_link_libraries("${CMAKE_PROJECT_NAME}-app" PRIVATE ${LIBRARY_LIST})
+target_compile_options("${CMAKE_PROJECT_NAME}-app" PRIVATE "$<$<CONFIG:PERF>:${PERF_COMPILE_FLAGS}>")
+target_compile_options("${CMAKE_PROJECT_NAME}-app" PRIVATE "$<$<CONFIG:MINSIZEREL>:${MINSIZE_COMPILE_FLAGS}>")
+target_link_libraries("${CMAKE_PROJECT_NAME}-app" PRIVATE ${LIBRARY_LIST} ${CMAKE_PM_ALLOCATOR_TARGET})
 )"""";
 }
 
@@ -158,6 +547,89 @@ const char* const header_file = R""""(#pragma once
 
 int sum(int a, int b);
 )"""";
+
+// %1% library, %2% its name in upper case (prefix of generated export macro)
+const char* const shared_header_file = R""""(#pragma once
+#include <%1%/%1%_export.h>
+
+%2%_EXPORT int sum(int a, int b);
+)"""";
+
+// Multiarch library: %1% library, %2% include of export header, %3% export macro
+const char* const multiarch_header_file = R""""(#pragma once
+#include <stddef.h>
+%2%
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sum of values, computed by the best variant built for CPU running it
+%3%float %1%_sum(const float* values, size_t count);
+// Forces variant (baseline, v2, v3 or v4 x86-64 level), returns 0 when it was not built or CPU does not support it.
+// NULL restores automatic selection.
+%3%int %1%_use_variant(const char* name);
+// Variant %1%_sum dispatches to
+%3%const char* %1%_variant(void);
+
+#ifdef __cplusplus
+}
+#endif
+)"""";
+
+// Header of synthetic library file: %1% library, %2% file index
+const char* const synthetic_header_file = R""""(#pragma once
+
+int %1%_file_%2%(int value);
+)"""";
+
+const char* const tracing_header_file = R""""(#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped zones are recorded into per-thread ring buffers and written as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev) when program exits.
+// Without CMAKE_PM_TRACING (CMake option of the same name) the macros expand to nothing.
+namespace tracing {
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Name must outlive the program, string literals are expected
+void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+// Trace file written at exit, TRACING_OUTPUT environment variable or trace.json by default; empty disables writing
+void set_output(const std::string& path);
+
+// Writes zones recorded so far, called automatically at exit
+void flush();
+
+class Zone {
+private:
+    const char* name;
+    uint64_t begin_ns;
+public:
+    explicit Zone(const char* name) : name(name), begin_ns(now_ns()) {}
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+    ~Zone() { record(name, begin_ns, now_ns()); }
+};
+
+}
+
+#define TRACING_CONCAT_IMPL(a, b) a##b
+#define TRACING_CONCAT(a, b) TRACING_CONCAT_IMPL(a, b)
+
+#ifdef CMAKE_PM_TRACING
+#define TRACE_ZONE(name) ::tracing::Zone TRACING_CONCAT(tracing_zone_, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_ZONE(__func__)
+#else
+#define TRACE_ZONE(name) static_cast<void>(0)
+#define TRACE_FUNCTION() static_cast<void>(0)
+#endif
+)"""";
 }
 
 namespace src {
@@ -171,16 +643,398 @@ endforeach()
 set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
 )"""";
 
-const char* const example_lib_file = R""""(#include <example_lib/example_lib.h>
+// %1% library
+const char* const example_lib_file = R""""(#include <%1%/%1%.h>
 
 int sum(int a, int b) { return a + b; }
 )"""";
 
-const char* const example_lib_cmake_file = R""""(set(LIB_NAME example_lib)
+// %1% library, %2% source extension, %3% library type keyword, %4% call making library shared
+const char* const example_lib_cmake_file = R""""(set(LIB_NAME %1%)
+file(GLOB_RECURSE HEADER_FILES "${PROJECT_SOURCE_DIR}/include/${LIB_NAME}/*.h")
+file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*%2%")
+add_library(${LIB_NAME}%3% ${SOURCE_FILES} ${HEADER_FILES})
+%4%target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")
+list(APPEND LIBRARY_LIST ${LIB_NAME})
+set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
+)"""";
+
+// %1% library
+const char* const example_module_file = R""""(export module %1%;
+
+export int sum(int a, int b) { return a + b; }
+)"""";
+
+// %1% library
+const char* const example_module_cmake_file = R""""(set(LIB_NAME %1%)
+file(GLOB_RECURSE MODULE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*.cppm")
+file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*.cpp")
+add_library(${LIB_NAME} ${SOURCE_FILES})
+target_sources(${LIB_NAME} PUBLIC FILE_SET CXX_MODULES BASE_DIRS "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}" FILES ${MODULE_FILES})
+target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")
+list(APPEND LIBRARY_LIST ${LIB_NAME})
+set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
+)"""";
+
+// Multiarch library dispatcher: %1% library, %2% source extension
+const char* const multiarch_file = R""""(#include <%1%/%1%.h>
+#include <string.h>
+
+typedef float (*%1%_sum_function)(const float*, size_t);
+
+// Kernels compiled from variants/kernel%2% once per x86-64 level, MULTIARCH_<level> is defined for built ones
+float %1%_sum_baseline(const float* values, size_t count);
+float %1%_sum_v2(const float* values, size_t count);
+float %1%_sum_v3(const float* values, size_t count);
+float %1%_sum_v4(const float* values, size_t count);
+
+struct %1%_variant {
+    const char* name;
+    %1%_sum_function function;
+};
+
+// Ordered from the best
+static const struct %1%_variant variants[] = {
+#ifdef MULTIARCH_V4
+    {"v4", %1%_sum_v4},
+#endif
+#ifdef MULTIARCH_V3
+    {"v3", %1%_sum_v3},
+#endif
+#ifdef MULTIARCH_V2
+    {"v2", %1%_sum_v2},
+#endif
+    {"baseline", %1%_sum_baseline}
+};
+
+static const struct %1%_variant* selected = NULL;
+
+static int supported(const char* name) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (strcmp(name, "v2") == 0) {
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    }
+    if (strcmp(name, "v3") == 0) {
+        return supported("v2") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+            && __builtin_cpu_supports("bmi2");
+    }
+    if (strcmp(name, "v4") == 0) {
+        return supported("v3") && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512dq")
+            && __builtin_cpu_supports("avx512vl");
+    }
+#endif
+    return strcmp(name, "baseline") == 0;
+}
+
+// Selected at first call, threads racing there all pick the same variant
+static const struct %1%_variant* current(void) {
+    const struct %1%_variant* variant = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+    if (!variant) {
+        size_t index = 0;
+        while (!supported(variants[index].name)) {
+            ++index;
+        }
+        variant = &variants[index];
+        __atomic_store_n(&selected, variant, __ATOMIC_RELEASE);
+    }
+    return variant;
+}
+
+float %1%_sum(const float* values, size_t count) {
+    return current()->function(values, count);
+}
+
+int %1%_use_variant(const char* name) {
+    if (!name) {
+        __atomic_store_n(&selected, NULL, __ATOMIC_RELEASE);
+        return 1;
+    }
+    for (size_t index = 0; index < sizeof(variants) / sizeof(variants[0]); ++index) {
+        if (strcmp(variants[index].name, name) == 0 && supported(name)) {
+            __atomic_store_n(&selected, &variants[index], __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* %1%_variant(void) {
+    return current()->name;
+}
+)"""";
+
+// Compiled once per variant with its -march level
+const char* const multiarch_kernel_file = R""""(#include <stddef.h>
+
+// Independent lanes let compiler vectorize with the widest registers of the level without reassociating
+// float additions, so every variant returns exactly the same sum; 64 lanes keep several vector additions
+// in flight even with 512-bit registers
+float KERNEL_NAME(const float* values, size_t count);
+
+float KERNEL_NAME(const float* values, size_t count) {
+    float lanes[64] = {0};
+    size_t index = 0;
+    for (; index + 64 <= count; index += 64) {
+        for (size_t lane = 0; lane < 64; ++lane) {
+            lanes[lane] += values[index + lane];
+        }
+    }
+    float sum = 0;
+    for (size_t lane = 0; lane < 64; ++lane) {
+        sum += lanes[lane];
+    }
+    for (; index < count; ++index) {
+        sum += values[index];
+    }
+    return sum;
+}
+)"""";
+
+// %1% library, %2% source extension, %3% library type keyword, %4% call making library shared
+const char* const multiarch_cmake_file = R""""(set(LIB_NAME %1%)
+file(GLOB HEADER_FILES "${PROJECT_SOURCE_DIR}/include/${LIB_NAME}/*.h")
+file(GLOB SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*%2%")
+add_library(${LIB_NAME}%3% ${SOURCE_FILES} ${HEADER_FILES})
+%4%target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")
+
+# Kernel is compiled once per x86-64 level the compiler knows into object library linked into ${LIB_NAME},
+# dispatcher picks the best level CPU supports. Every level is explicit (appended after profile flags),
+# so baseline kernel and dispatcher are not built for host ISA by -march=native of perf profile.
+include(CheckCompilerFlag)
+set(VARIANTS baseline)
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64")
+    list(APPEND VARIANTS v2 v3 v4)
+endif()
+foreach(VARIANT ${VARIANTS})
+    set(VARIANT_TARGET ${LIB_NAME}_${VARIANT})
+    set(VARIANT_FLAG "")
+    if(CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64")
+        if(VARIANT STREQUAL "baseline")
+            set(VARIANT_FLAG "-march=x86-64")
+        else()
+            set(VARIANT_FLAG "-march=x86-64-${VARIANT}")
+        endif()
+        check_compiler_flag(${PROJECT_LANGUAGE} ${VARIANT_FLAG} CMAKE_PM_HAS_X86_64_${VARIANT})
+        if(NOT CMAKE_PM_HAS_X86_64_${VARIANT})
+            set(VARIANT_FLAG "")
+        endif()
+    endif()
+    if(VARIANT STREQUAL "baseline")
+        target_compile_options(${LIB_NAME} PRIVATE ${VARIANT_FLAG})
+    elseif(VARIANT_FLAG)
+        string(TOUPPER ${VARIANT} VARIANT_MACRO)
+        target_compile_definitions(${LIB_NAME} PRIVATE MULTIARCH_${VARIANT_MACRO})
+    else()
+        continue()
+    endif()
+    add_library(${VARIANT_TARGET} OBJECT "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/variants/kernel%2%")
+    target_compile_definitions(${VARIANT_TARGET} PRIVATE KERNEL_NAME=${LIB_NAME}_sum_${VARIANT})
+    target_compile_options(${VARIANT_TARGET} PRIVATE ${VARIANT_FLAG})
+    set_target_properties(${VARIANT_TARGET} PROPERTIES
+        POSITION_INDEPENDENT_CODE ON
+        C_VISIBILITY_PRESET hidden
+        CXX_VISIBILITY_PRESET hidden)
+    target_sources(${LIB_NAME} PRIVATE $<TARGET_OBJECTS:${VARIANT_TARGET}>)
+endforeach()
+list(APPEND LIBRARY_LIST ${LIB_NAME})
+set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
+)"""";
+
+// Synthetic library file: %1% library, %2% file index, %3% includes of dependencies,
+// %4% dependency functions and %5% their count
+const char* const synthetic_file = R""""(#include <%1%/file_%2%.h>
+%3%
+static int (*const dependencies[])(int) = {%4%};
+
+int %1%_file_%2%(int value) {
+    return dependencies[value %% %5%](0) * 0 + value + %2%;
+}
+)"""";
+
+const char* const synthetic_leaf_file = R""""(#include <%1%/file_%2%.h>
+
+int %1%_file_%2%(int value) {
+    return value + %2%;
+}
+)"""";
+
+// %1% library, %2% file extension, %3% linking of dependencies
+const char* const synthetic_cmake_file = R""""(set(LIB_NAME %1%)
 file(GLOB_RECURSE HEADER_FILES "${PROJECT_SOURCE_DIR}/include/${LIB_NAME}/*.h")
-file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*%1%")
+file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*%2%")
 add_library(${LIB_NAME} ${SOURCE_FILES} ${HEADER_FILES})
 target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")
+%3%list(APPEND LIBRARY_LIST ${LIB_NAME})
+set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
+)"""";
+
+const char* const tracing_file = R""""(#include <tracing/tracing.h>
+
+#ifdef CMAKE_PM_TRACING
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace tracing {
+
+namespace {
+
+// Slot is a seqlock: odd sequence while its owner writes, 2 * (index + 1) once event index is complete.
+// Fields are relaxed atomics, so a reader copying slot that is being overwritten races with nothing and drops the copy.
+struct Event {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> begin_ns{0};
+    std::atomic<uint64_t> end_ns{0};
+    std::atomic<uint32_t> thread_id{0};
+};
+
+// Written only by the thread owning it; when full the oldest events are overwritten
+struct ThreadBuffer {
+    static constexpr size_t capacity = 1 << 16;
+    std::array<Event, capacity> events;
+    std::atomic<uint64_t> head{0};
+};
+
+struct Registry {
+    std::mutex mutex;
+    // Never freed: threads may still record while exit handlers run.
+    // Buffers of exited threads are reused by new ones, their recorded events stay until overwritten.
+    std::vector<ThreadBuffer*> buffers;
+    std::vector<ThreadBuffer*> free_buffers;
+    uint32_t threads = 0;
+    std::string output;
+
+    Registry() {
+        const char* path = std::getenv("TRACING_OUTPUT");
+        output = path ? path : "trace.json";
+        std::atexit(flush);
+    }
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct ThreadState {
+    ThreadBuffer* buffer = nullptr;
+    uint32_t thread_id = 0;
+
+    ThreadState() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        thread_id = ++reg.threads;
+        if (!reg.free_buffers.empty()) {
+            buffer = reg.free_buffers.back();
+            reg.free_buffers.pop_back();
+        } else {
+            buffer = new ThreadBuffer();
+            reg.buffers.push_back(buffer);
+        }
+    }
+
+    ~ThreadState() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.free_buffers.push_back(buffer);
+        buffer = nullptr;
+    }
+};
+
+void write_escaped(std::ostream& out, const char* text) {
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') {
+            out << '\\';
+        }
+        out << *text;
+    }
+}
+
+}
+
+void record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+    thread_local ThreadState state;
+    ThreadBuffer* buffer = state.buffer;
+    // Zones closed by destructors running after thread exit cleanup are dropped
+    if (!buffer) {
+        return;
+    }
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event& event = buffer->events[head % ThreadBuffer::capacity];
+    event.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    event.end_ns.store(end_ns, std::memory_order_relaxed);
+    event.thread_id.store(state.thread_id, std::memory_order_relaxed);
+    event.sequence.store(2 * head + 2, std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void set_output(const std::string& path) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.output = path;
+}
+
+void flush() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (reg.output.empty()) {
+        return;
+    }
+    std::ofstream out(reg.output);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    char timing[64];
+    for (ThreadBuffer* buffer : reg.buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ThreadBuffer::capacity ? head - ThreadBuffer::capacity : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            // Copy is kept only if the slot still holds event i after reading it (recording thread may be running)
+            const Event& event = buffer->events[i % ThreadBuffer::capacity];
+            uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+            const char* name = event.name.load(std::memory_order_relaxed);
+            uint64_t begin_ns = event.begin_ns.load(std::memory_order_relaxed);
+            uint64_t end_ns = event.end_ns.load(std::memory_order_relaxed);
+            uint32_t thread_id = event.thread_id.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence != 2 * i + 2 || event.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            std::snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f",
+                begin_ns / 1000.0, (end_ns - begin_ns) / 1000.0);
+            out << (first ? "\n" : ",\n") << "{\"name\":\"";
+            write_escaped(out, name);
+            out << "\",\"ph\":\"X\"," << timing << ",\"pid\":1,\"tid\":" << thread_id << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+}
+#endif
+)"""";
+
+const char* const tracing_cmake_file = R""""(set(LIB_NAME tracing)
+option(CMAKE_PM_TRACING "Record tracing zones and write Chrome trace at exit" ON)
+file(GLOB_RECURSE HEADER_FILES "${PROJECT_SOURCE_DIR}/include/${LIB_NAME}/*.h")
+file(GLOB_RECURSE SOURCE_FILES "${PROJECT_SOURCE_DIR}/src/${LIB_NAME}/*.cpp")
+add_library(${LIB_NAME} ${SOURCE_FILES} ${HEADER_FILES})
+target_include_directories(${LIB_NAME} PUBLIC "${PROJECT_SOURCE_DIR}/include")
+if(CMAKE_PM_TRACING)
+    find_package(Threads REQUIRED)
+    target_compile_definitions(${LIB_NAME} PUBLIC CMAKE_PM_TRACING)
+    target_link_libraries(${LIB_NAME} PUBLIC Threads::Threads)
+endif()
 list(APPEND LIBRARY_LIST ${LIB_NAME})
 set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
 )"""";
@@ -188,9 +1042,19 @@ set(LIBRARY_LIST ${LIBRARY_LIST} PARENT_SCOPE)
 
 namespace docs {
 
-const char* const cmake_file = R""""(set(DOXYGEN_EXTRACT_ALL YES)
+const char* const cmake_file = R""""(cmake_host_system_information(RESULT DOCS_THREADS QUERY NUMBER_OF_LOGICAL_CORES)
+set(DOXYGEN_EXTRACT_ALL YES)
 set(DOXYGEN_BUILTIN_STL_SUPPORT YES)
-doxygen_add_docs(docs "${PROJECT_SOURCE_DIR}")
+set(DOXYGEN_NUM_PROC_THREADS ${DOCS_THREADS})
+set(DOXYGEN_DOT_NUM_THREADS ${DOCS_THREADS})
+
+# Only project sources are scanned (not build trees or CPM cache), docs are regenerated when one of them changes
+file(GLOB_RECURSE DOCS_SOURCES CONFIGURE_DEPENDS
+    "${PROJECT_SOURCE_DIR}/include/*"
+    "${PROJECT_SOURCE_DIR}/src/*"
+    "${PROJECT_SOURCE_DIR}/docs/*")
+list(FILTER DOCS_SOURCES EXCLUDE REGEX "/CMakeLists\\.txt$")
+doxygen_add_docs(docs ${DOCS_SOURCES} USE_STAMP_FILE)
 )"""";
 
 const char* const mainpage_file = R""""(# Documentation for %1% project {#mainpage}
@@ -201,33 +1065,821 @@ This is docs for your project!
 namespace test {
 
 const char* const main_file = R""""(#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Appends one JSON line per test to TEST_PERF_OUTPUT (test_perf.jsonl in test working directory):
+// wall and CPU time, growth of max RSS and, when perf_event_open is allowed, cycles and instructions.
+// Lines are written with single O_APPEND write, so tests run in parallel by ctest do not interleave.
+class PerformanceListener : public ::testing::EmptyTestEventListener {
+private:
+    int output = -1;
+    int cycles = -1;
+    int instructions = -1;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start = 0;
+    long max_rss_start = 0;
+
+    static double cpu_seconds() {
+        timespec now;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+    static long max_rss_kb() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    static std::string escaped(const char* text) {
+        std::string result;
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                result += '\\';
+            }
+            result += *text;
+        }
+        return result;
+    }
+
+#ifdef __linux__
+    static int open_counter(uint64_t config, int group) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = config;
+        attributes.disabled = group == -1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.inherit = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0));
+    }
+
+    static uint64_t read_counter(int counter) {
+        uint64_t value = 0;
+        return read(counter, &value, sizeof(value)) == sizeof(value) ? value : 0;
+    }
+#endif
+
+    static std::string counter_json(int counter) {
+#ifdef __linux__
+        if (counter >= 0) {
+            return std::to_string(read_counter(counter));
+        }
+#endif
+        return "null";
+    }
+public:
+    PerformanceListener() {
+        const char* path = std::getenv("TEST_PERF_OUTPUT");
+        output = open(path ? path : "test_perf.jsonl", O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#ifdef __linux__
+        cycles = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (cycles >= 0) {
+            instructions = open_counter(PERF_COUNT_HW_INSTRUCTIONS, cycles);
+        }
+#endif
+    }
+
+    ~PerformanceListener() override {
+        for (int descriptor : {output, cycles, instructions}) {
+            if (descriptor >= 0) {
+                close(descriptor);
+            }
+        }
+    }
+
+    void OnTestStart(const ::testing::TestInfo&) override {
+#ifdef __linux__
+        if (cycles >= 0) {
+            ioctl(cycles, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(cycles, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        max_rss_start = max_rss_kb();
+        cpu_start = cpu_seconds();
+        wall_start = std::chrono::steady_clock::now();
+    }
+
+    void OnTestEnd(const ::testing::TestInfo& info) override {
+        std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - wall_start;
+        double cpu_ms = (cpu_seconds() - cpu_start) * 1000;
+#ifdef __linux__
+        if (cycles >= 0) {
+            ioctl(cycles, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        if (output < 0) {
+            return;
+        }
+        const char* result = info.result()->Skipped() ? "skipped" : info.result()->Passed() ? "passed" : "failed";
+        std::string line = "{\"suite\":\"" + escaped(info.test_suite_name())
+            + "\",\"test\":\"" + escaped(info.name())
+            + "\",\"result\":\"" + result
+            + "\",\"wall_ms\":" + std::to_string(wall.count())
+            + ",\"cpu_ms\":" + std::to_string(cpu_ms)
+            + ",\"max_rss_delta_kb\":" + std::to_string(max_rss_kb() - max_rss_start)
+            + ",\"cycles\":" + counter_json(cycles)
+            + ",\"instructions\":" + counter_json(instructions) + "}\n";
+        if (write(output, line.data(), line.size()) < 0) {
+            close(output);
+            output = -1;
+        }
+    }
+};
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
+    ::testing::UnitTest::GetInstance()->listeners().Append(new PerformanceListener());
     return RUN_ALL_TESTS();
 }
 )"""";
 
 const char* const cmake_file = R""""(find_package(GTest REQUIRED)
-file(GLOB_RECURSE TEST_FILES "./*.cpp")
-add_executable(test_exec ${TEST_FILES})
-target_link_libraries(test_exec PRIVATE GTest::gtest_main ${LIBRARY_LIST})
-gtest_discover_tests(test_exec)
+# main() is compiled once and shared by every test executable
+add_library(test_main OBJECT main.cpp)
+target_link_libraries(test_main PUBLIC GTest::gtest)
+add_custom_target(tests)
+
+# Executable per test/<lib> directory linked only with its library, so change of one library relinks only its tests.
+# Tests are listed right before ctest runs them (PRE_TEST) instead of after every link.
+file(GLOB V_GLOB LIST_DIRECTORIES true "*")
+foreach(item ${V_GLOB})
+    get_filename_component(TEST_DIR_NAME ${item} NAME)
+    file(GLOB_RECURSE TEST_FILES "${item}/*.cpp")
+    if(IS_DIRECTORY ${item} AND TEST_FILES)
+        set(TEST_NAME "${TEST_DIR_NAME}_test")
+        add_executable(${TEST_NAME} ${TEST_FILES})
+        if(TARGET ${TEST_DIR_NAME})
+            target_link_libraries(${TEST_NAME} PRIVATE test_main ${TEST_DIR_NAME} ${CMAKE_PM_ALLOCATOR_TARGET})
+        else()
+            target_link_libraries(${TEST_NAME} PRIVATE test_main ${LIBRARY_LIST} ${CMAKE_PM_ALLOCATOR_TARGET})
+        endif()
+        gtest_discover_tests(${TEST_NAME} DISCOVERY_MODE PRE_TEST PROPERTIES LABELS ${TEST_DIR_NAME})
+        add_dependencies(tests ${TEST_NAME})
+    endif()
+endforeach()
+
+# Tests placed directly in test/ link every library
+file(GLOB TEST_FILES "*.cpp")
+list(REMOVE_ITEM TEST_FILES "${CMAKE_CURRENT_SOURCE_DIR}/main.cpp")
+if(TEST_FILES)
+    add_executable(test_exec ${TEST_FILES})
+    target_link_libraries(test_exec PRIVATE test_main ${LIBRARY_LIST} ${CMAKE_PM_ALLOCATOR_TARGET})
+    gtest_discover_tests(test_exec DISCOVERY_MODE PRE_TEST)
+    add_dependencies(tests test_exec)
+endif()
 )"""";
 
+// Test stubs of library: %1% library, %2% test suite
 const char* const example_lib_c_file = R""""(#include <gtest/gtest.h>
 extern "C"{
-    #include <example_lib/example_lib.h>
+    #include <%1%/%1%.h>
 }
 
-TEST(ExampleTests, TestFive_Five){ ASSERT_EQ(10, sum(5, 5)); }
+TEST(%2%, TestFive_Five){ ASSERT_EQ(10, sum(5, 5)); }
 )"""";
 
 const char* const example_lib_cpp_file = R""""(#include <gtest/gtest.h>
-#include <example_lib/example_lib.h>
+#include <%1%/%1%.h>
+
+TEST(%2%, TestFive_Five){ ASSERT_EQ(10, sum(5, 5)); }
+)"""";
+
+const char* const example_lib_module_file = R""""(#include <gtest/gtest.h>
+import %1%;
+
+TEST(%2%, TestFive_Five){ ASSERT_EQ(10, sum(5, 5)); }
+)"""";
+
+// Multiarch library test: %1% library, %2% test suite
+const char* const multiarch_file = R""""(#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <%1%/%1%.h>
+
+class %2% : public ::testing::TestWithParam<const char*> {
+protected:
+    // Tests running later get the variant dispatcher picks for this CPU
+    void TearDown() override {
+        %1%_use_variant(NULL);
+    }
+};
+
+// Every variant is forced in turn, the ones not built or not supported by this CPU are skipped
+TEST_P(%2%, MatchesBaseline) {
+    std::vector<float> values(1000 + 13);
+    for (size_t index = 0; index < values.size(); ++index) {
+        values[index] = 0.25f * (index %% 17);
+    }
+    ASSERT_TRUE(%1%_use_variant("baseline"));
+    float expected = %1%_sum(values.data(), values.size());
+    if (!%1%_use_variant(GetParam())) {
+        GTEST_SKIP() << GetParam() << " is not built or not supported by CPU";
+    }
+    EXPECT_STREQ(GetParam(), %1%_variant());
+    EXPECT_EQ(expected, %1%_sum(values.data(), values.size()));
+}
+
+INSTANTIATE_TEST_SUITE_P(Variants, %2%, ::testing::Values("baseline", "v2", "v3", "v4"));
+
+TEST(%2%Dispatch, RejectsUnknownVariant) {
+    EXPECT_FALSE(%1%_use_variant("v9"));
+}
+
+TEST(%2%Dispatch, RestoresAutomaticSelection) {
+    std::string automatic = %1%_variant();
+    ASSERT_TRUE(%1%_use_variant("baseline"));
+    ASSERT_TRUE(%1%_use_variant(NULL));
+    EXPECT_EQ(automatic, %1%_variant());
+}
+)"""";
+
+// %1% test suite, %2% includes, %3% assertions
+const char* const synthetic_file = R""""(#include <gtest/gtest.h>
+%2%
+TEST(%1%, Files) {
+%3%}
+)"""";
+
+const char* const tracing_file = R""""(#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <tracing/tracing.h>
+
+TEST(TracingTests, ZoneOverhead) {
+#ifdef CMAKE_PM_TRACING
+    // Trace of this loop is not interesting
+    tracing::set_output("");
+#endif
+    constexpr int zones = 1000000;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < zones; ++i) {
+        TRACE_ZONE("overhead");
+    }
+    double ns_per_zone = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / zones;
+    std::cout << "Tracing zone overhead: " << ns_per_zone << " ns" << std::endl;
+    // Reported only: wall clock thresholds are flaky on loaded machines and under sanitizers
+    RecordProperty("ns_per_zone", std::to_string(ns_per_zone));
+}
+)"""";
+
+}
+
+namespace bench {
+
+const char* const cmake_file = R""""(find_package(Threads REQUIRED)
+add_executable(allocation_churn_system allocation_churn.cpp)
+add_executable(allocation_churn allocation_churn.cpp)
+target_compile_definitions(allocation_churn_system PRIVATE BENCH_ALLOCATOR="system")
+target_compile_definitions(allocation_churn PRIVATE BENCH_ALLOCATOR="${CMAKE_PM_ALLOCATOR}")
+target_link_libraries(allocation_churn_system PRIVATE Threads::Threads)
+target_link_libraries(allocation_churn PRIVATE Threads::Threads ${CMAKE_PM_ALLOCATOR_TARGET})
+add_custom_target(run_benchmarks
+    COMMAND allocation_churn_system
+    COMMAND allocation_churn
+    USES_TERMINAL)
+)"""";
+
+const char* const allocation_churn_file = R""""(#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Short lived blocks of mixed sizes replacing each other, plus bursts of strings in growing vector
+static void churn(size_t operations, unsigned seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> size(8, 1024);
+    std::vector<std::unique_ptr<char[]>> live(4096);
+    std::uniform_int_distribution<size_t> slot(0, live.size() - 1);
+    for (size_t i = 0; i < operations; ++i) {
+        std::unique_ptr<char[]>& block = live[slot(random)];
+        block.reset(new char[size(random)]);
+        block[0] = static_cast<char>(i);
+        if (i % 64 == 0) {
+            std::vector<std::string> words;
+            for (size_t word = 0; word < 64; ++word) {
+                words.emplace_back(16 + word, 'x');
+            }
+        }
+    }
+}
+
+static double run(size_t threads, size_t operations) {
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t thread = 0; thread < threads; ++thread) {
+        workers.emplace_back(churn, operations, static_cast<unsigned>(thread + 1));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
 
-TEST(ExampleTests, TestFive_Five){ ASSERT_EQ(10, sum(5, 5)); }
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    std::vector<size_t> thread_counts = {1};
+    if (std::thread::hardware_concurrency() > 1) {
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+    for (size_t threads : thread_counts) {
+        double seconds = run(threads, operations);
+        std::printf("%-10s %3zu threads: %8.2f M operations/s\n", BENCH_ALLOCATOR, threads, threads * operations / seconds / 1e6);
+    }
+}
+)"""";
+
+// Multiarch library benchmark: %1% library
+const char* const multiarch_cmake_file = R""""(add_executable(%1%_bench %1%_bench.cpp)
+target_link_libraries(%1%_bench PRIVATE %1%)
+if(NOT TARGET run_benchmarks)
+    add_custom_target(run_benchmarks)
+endif()
+add_custom_target(run_%1%_bench COMMAND %1%_bench USES_TERMINAL)
+add_dependencies(run_benchmarks run_%1%_bench)
+)"""";
+
+const char* const multiarch_file = R""""(#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <%1%/%1%.h>
+
+// Throughput of every variant built and supported by this CPU, on array fitting into L1 cache
+int main() {
+    std::vector<float> values(1 << 12, 1.0f);
+    const int rounds = 5;
+    const int repeats = 20000;
+    for (const char* variant : {"baseline", "v2", "v3", "v4"}) {
+        if (!%1%_use_variant(variant)) {
+            std::printf("%%-10s not built or not supported by CPU\n", variant);
+            continue;
+        }
+        // Best of several rounds, first ones also warm up cache and clock frequency
+        double best = 0;
+        for (int round = 0; round < rounds; ++round) {
+            volatile float sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int repeat = 0; repeat < repeats; ++repeat) {
+                sink = sink + %1%_sum(values.data(), values.size());
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::max(best, static_cast<double>(repeats) * values.size() * sizeof(float) / elapsed.count());
+        }
+        std::printf("%%-10s %%8.2f GB/s\n", variant, best / 1e9);
+    }
+}
 )"""";
+}
+
+namespace tools {
+
+const char* const heapprof_cmake_file = R""""(# Heap profiler preloaded by cmake-pm run --heap, built only on request
+find_package(Threads REQUIRED)
+add_library(heapprof SHARED heapprof.cpp)
+target_link_libraries(heapprof PRIVATE ${CMAKE_DL_LIBS} Threads::Threads)
+)"""";
+
+const char* const heapprof_file = R""""(// Allocation profiler preloaded into app by cmake-pm run --heap (glibc, LD_PRELOAD).
+// Allocations are sampled every HEAPPROF_SAMPLE bytes (512 KiB by default) with their backtrace into thread-local
+// buffers, resident set size is sampled every HEAPPROF_INTERVAL ms (10 by default). At exit top HEAPPROF_TOP (20)
+// allocation sites are written to heapprof.<pid>.txt and RSS timeline to heapprof.<pid>.rss.csv in HEAPPROF_DIR.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+#define HEAPPROF_TLS __attribute__((tls_model("initial-exec"))) thread_local
+
+namespace {
+
+constexpr int max_frames = 24;
+constexpr size_t buffer_capacity = 512;
+constexpr size_t max_rss_samples = 1 << 14;
+
+struct Sample {
+    void* frames[max_frames];
+    int depth;
+    size_t size;
+};
+
+// Appended by its own thread, merged into sites by it when full and by exit handler; both hold the lock
+struct ThreadBuffer {
+    Sample samples[buffer_capacity];
+    size_t count = 0;
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    ThreadBuffer* next = nullptr;
+};
+
+class BufferLock {
+private:
+    ThreadBuffer& buffer;
+public:
+    explicit BufferLock(ThreadBuffer& buffer) : buffer(buffer) {
+        while (buffer.lock.test_and_set(std::memory_order_acquire)) {
+            sched_yield();
+        }
+    }
+    BufferLock(const BufferLock&) = delete;
+    BufferLock& operator=(const BufferLock&) = delete;
+    ~BufferLock() { buffer.lock.clear(std::memory_order_release); }
+};
+
+struct Site {
+    uint64_t samples = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+struct RssSample {
+    uint64_t ms;
+    uint64_t kb;
+};
+
+// Plain globals: allocations start before constructors run and continue after destructors
+int64_t sample_interval = 512 * 1024;
+std::atomic<ThreadBuffer*> buffers{nullptr};
+std::mutex sites_mutex;
+std::unordered_map<std::string, Site>* sites = nullptr;
+RssSample rss_samples[max_rss_samples];
+std::atomic<size_t> rss_count{0};
+// Sampler is joined at exit before timeline is read, running is guarded by sampler_mutex.
+// pthread types are used because they have no destructor to run at exit while sampler waits.
+pthread_mutex_t sampler_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t sampler_wake;
+bool running = false;
+bool sampler_started = false;
+pthread_t sampler;
+timespec start_time;
+// Executable segment of profiler: leading frames inside it are dropped, however compiler inlined hooks
+uintptr_t own_code_begin = 0;
+uintptr_t own_code_end = 0;
+
+// Allocations of the profiler itself (and of backtrace() loading unwinder) are not sampled
+HEAPPROF_TLS bool busy = false;
+HEAPPROF_TLS int64_t until_sample = 0;
+HEAPPROF_TLS ThreadBuffer* buffer = nullptr;
+
+uint64_t elapsed_ms() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start_time.tv_sec) * 1000 + (now.tv_nsec - start_time.tv_nsec) / 1000000;
+}
+
+uint64_t resident_kb() {
+    char text[128] = {};
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    unsigned long long size = 0, resident = 0;
+    if (length <= 0 || std::sscanf(text, "%llu %llu", &size, &resident) != 2) {
+        return 0;
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+bool own_code(void* frame) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(frame);
+    return address >= own_code_begin && address < own_code_end;
+}
+
+// Called for every loaded module, stops at the one whose executable segment holds this function
+int find_own_code(dl_phdr_info* info, size_t, void*) {
+    uintptr_t self = reinterpret_cast<uintptr_t>(&find_own_code);
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+        uintptr_t begin = info->dlpi_addr + segment.p_vaddr;
+        if (segment.p_type == PT_LOAD && (segment.p_flags & PF_X)
+                && self >= begin && self < begin + segment.p_memsz) {
+            own_code_begin = begin;
+            own_code_end = begin + segment.p_memsz;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Estimated allocations and bytes behind one sample: large allocations are sampled almost surely,
+// small ones stand for every allocation of their size in sampling interval. Caller holds lock of the buffer.
+void merge(ThreadBuffer& from) {
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    if (!sites) {
+        sites = new std::unordered_map<std::string, Site>();
+    }
+    for (size_t i = 0; i < from.count; ++i) {
+        const Sample& sample = from.samples[i];
+        int first = 0;
+        while (first < sample.depth && own_code(sample.frames[first])) {
+            ++first;
+        }
+        Site& site = (*sites)[std::string(reinterpret_cast<const char*>(sample.frames + first),
+            (sample.depth - first) * sizeof(void*))];
+        uint64_t size = std::max<uint64_t>(sample.size, 1);
+        site.samples += 1;
+        site.allocations += std::max<uint64_t>(1, sample_interval / size);
+        site.bytes += std::max<uint64_t>(size, sample_interval);
+    }
+    from.count = 0;
+}
+
+__attribute__((noinline)) void record(size_t size) {
+    if (busy) {
+        return;
+    }
+    busy = true;
+    if (!buffer) {
+        buffer = new (__libc_malloc(sizeof(ThreadBuffer))) ThreadBuffer();
+        buffer->next = buffers.load();
+        while (!buffers.compare_exchange_weak(buffer->next, buffer)) {
+        }
+    }
+    // Unwinding is done outside of the lock, exit handler does not wait for it
+    Sample sample;
+    sample.depth = backtrace(sample.frames, max_frames);
+    sample.size = size;
+    {
+        BufferLock lock(*buffer);
+        if (buffer->count == buffer_capacity) {
+            merge(*buffer);
+        }
+        buffer->samples[buffer->count] = sample;
+        ++buffer->count;
+    }
+    busy = false;
+}
+
+inline void allocated(size_t size) {
+    until_sample -= static_cast<int64_t>(size);
+    if (until_sample < 0) {
+        until_sample = sample_interval;
+        record(size);
+    }
+}
+
+// Timeline keeps every other sample when full, so long runs are covered with coarser resolution
+void* sample_rss(void* argument) {
+    busy = true;
+    uint64_t interval_ms = reinterpret_cast<uintptr_t>(argument);
+    pthread_mutex_lock(&sampler_mutex);
+    while (running) {
+        size_t count = rss_count.load();
+        if (count == max_rss_samples) {
+            for (size_t i = 0; i < max_rss_samples / 2; ++i) {
+                rss_samples[i] = rss_samples[2 * i];
+            }
+            count = max_rss_samples / 2;
+            interval_ms *= 2;
+        }
+        rss_samples[count] = {elapsed_ms(), resident_kb()};
+        rss_count.store(count + 1);
+        timespec wake;
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        wake.tv_sec += interval_ms / 1000;
+        wake.tv_nsec += interval_ms % 1000 * 1000000;
+        if (wake.tv_nsec >= 1000000000) {
+            wake.tv_sec += 1;
+            wake.tv_nsec -= 1000000000;
+        }
+        while (running && pthread_cond_timedwait(&sampler_wake, &sampler_mutex, &wake) == 0) {
+        }
+    }
+    pthread_mutex_unlock(&sampler_mutex);
+    return nullptr;
+}
+
+// Only the forking thread survives in child: profiler mutexes are taken around fork so that no lost thread
+// holds them, buffer locks of lost threads are released (their unfinished sample is not counted yet)
+// and child keeps profiling without the sampler
+void before_fork() {
+    pthread_mutex_lock(&sampler_mutex);
+    sites_mutex.lock();
+}
+
+void after_fork_parent() {
+    sites_mutex.unlock();
+    pthread_mutex_unlock(&sampler_mutex);
+}
+
+void after_fork_child() {
+    sites_mutex.unlock();
+    pthread_mutex_unlock(&sampler_mutex);
+    running = false;
+    sampler_started = false;
+    for (ThreadBuffer* thread = buffers.load(); thread; thread = thread->next) {
+        thread->lock.clear(std::memory_order_release);
+    }
+}
+
+std::string describe(void* frame) {
+    Dl_info info = {};
+    char text[64];
+    if (!dladdr(frame, &info) || !info.dli_fname) {
+        std::snprintf(text, sizeof(text), "%p", frame);
+        return text;
+    }
+    const char* module = std::strrchr(info.dli_fname, '/');
+    module = module ? module + 1 : info.dli_fname;
+    if (info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : info.dli_sname;
+        std::free(demangled);
+        std::snprintf(text, sizeof(text), "+0x%zx (", static_cast<size_t>(
+            static_cast<char*>(frame) - static_cast<char*>(info.dli_saddr)));
+        return name + text + module + ")";
+    }
+    // Offset in module, for addr2line -e <module> when symbols are not exported
+    std::snprintf(text, sizeof(text), "+0x%zx", static_cast<size_t>(
+        static_cast<char*>(frame) - static_cast<char*>(info.dli_fbase)));
+    return module + std::string(text);
+}
 
+__attribute__((constructor)) void start() {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    dl_iterate_phdr(find_own_code, nullptr);
+    if (const char* sample = std::getenv("HEAPPROF_SAMPLE")) {
+        sample_interval = std::max(1LL, std::atoll(sample));
+    }
+    // Programs started by app are not profiled
+    unsetenv("LD_PRELOAD");
+    const char* interval = std::getenv("HEAPPROF_INTERVAL");
+    uintptr_t interval_ms = interval ? std::max(1LL, std::atoll(interval)) : 10;
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&sampler_wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    running = true;
+    sampler_started = pthread_create(&sampler, nullptr, sample_rss, reinterpret_cast<void*>(interval_ms)) == 0;
+    pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+}
+
+__attribute__((destructor)) void finish() {
+    busy = true;
+    if (sampler_started) {
+        pthread_mutex_lock(&sampler_mutex);
+        running = false;
+        pthread_cond_signal(&sampler_wake);
+        pthread_mutex_unlock(&sampler_mutex);
+        pthread_join(sampler, nullptr);
+        sampler_started = false;
+    }
+    size_t count = rss_count.load();
+    if (count < max_rss_samples) {
+        rss_samples[count] = {elapsed_ms(), resident_kb()};
+        rss_count.store(++count);
+    }
+    for (ThreadBuffer* thread = buffers.load(); thread; thread = thread->next) {
+        BufferLock lock(*thread);
+        merge(*thread);
+    }
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    std::vector<std::pair<std::string, Site>> ranked;
+    uint64_t total_bytes = 0, total_allocations = 0;
+    if (sites) {
+        for (const auto& site : *sites) {
+            ranked.push_back(site);
+            total_bytes += site.second.bytes;
+            total_allocations += site.second.allocations;
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) {
+        return left.second.bytes > right.second.bytes;
+    });
+    const char* top = std::getenv("HEAPPROF_TOP");
+    ranked.resize(std::min<size_t>(ranked.size(), top ? std::max(1, std::atoi(top)) : 20));
+    RssSample peak = {0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        if (rss_samples[i].kb > peak.kb) {
+            peak = rss_samples[i];
+        }
+    }
+
+    const char* directory = std::getenv("HEAPPROF_DIR");
+    std::string prefix = std::string(directory ? directory : ".") + "/heapprof." + std::to_string(getpid());
+    if (FILE* timeline = std::fopen((prefix + ".rss.csv").c_str(), "w")) {
+        std::fprintf(timeline, "ms,rss_kb\n");
+        for (size_t i = 0; i < count; ++i) {
+            std::fprintf(timeline, "%llu,%llu\n",
+                static_cast<unsigned long long>(rss_samples[i].ms), static_cast<unsigned long long>(rss_samples[i].kb));
+        }
+        std::fclose(timeline);
+    }
+    FILE* report = std::fopen((prefix + ".txt").c_str(), "w");
+    if (!report) {
+        return;
+    }
+    std::fprintf(report, "Estimated %llu allocations, %.1f MiB (sampled every %lld bytes)\n",
+        static_cast<unsigned long long>(total_allocations), total_bytes / 1048576.0,
+        static_cast<long long>(sample_interval));
+    std::fprintf(report, "Peak RSS %.1f MiB at %.3f s, timeline in %s.rss.csv\n",
+        peak.kb / 1024.0, peak.ms / 1000.0, prefix.c_str());
+    std::fprintf(report, "Frames without exported symbol are module+offset: addr2line -f -C -e <module> <offset>\n\n");
+    for (size_t rank = 0; rank < ranked.size(); ++rank) {
+        const Site& site = ranked[rank].second;
+        std::fprintf(report, "#%zu %.1f MiB (%.1f%%), %llu allocations, %llu samples\n", rank + 1,
+            site.bytes / 1048576.0, total_bytes ? 100.0 * site.bytes / total_bytes : 0.0,
+            static_cast<unsigned long long>(site.allocations), static_cast<unsigned long long>(site.samples));
+        const std::string& stack = ranked[rank].first;
+        for (size_t frame = 0; frame < stack.size() / sizeof(void*); ++frame) {
+            void* address;
+            std::memcpy(&address, stack.data() + frame * sizeof(void*), sizeof(void*));
+            std::fprintf(report, "    %s\n", describe(address).c_str());
+        }
+        std::fprintf(report, "\n");
+    }
+    std::fclose(report);
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    allocated(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    size_t total = 0;
+    // Overflowing request fails in libc, nothing is allocated
+    if (!__builtin_mul_overflow(count, size, &total)) {
+        allocated(total);
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    allocated(size);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    allocated(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    allocated(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    allocated(size);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : ENOMEM;
+}
+
+}
+)"""";
 }
 
 namespace scripts {
@@ -253,18 +1905,47 @@ macro(cmake_pm_add_tests)
     endif()
 endmacro()
 
+# Dependency graph is plotted outside of ALL (unless CMAKE_PM_GRAPHVIZ_ALL is ON) and only after CMakeLists or target set changed
+function(cmake_pm_write_target_set)
+    set(targets "")
+    set(directories "${PROJECT_SOURCE_DIR}")
+    while(directories)
+        list(POP_FRONT directories directory)
+        get_property(directory_targets DIRECTORY "${directory}" PROPERTY BUILDSYSTEM_TARGETS)
+        get_property(subdirectories DIRECTORY "${directory}" PROPERTY SUBDIRECTORIES)
+        list(APPEND targets ${directory_targets})
+        list(APPEND directories ${subdirectories})
+    endwhile()
+    list(SORT targets)
+    string(REPLACE ";" "\n" targets "${targets}")
+    # Rewritten only when content differs, so unchanged target set keeps graph up to date
+    file(CONFIGURE OUTPUT "${PROJECT_BINARY_DIR}/graphviz/targets.txt" CONTENT "${targets}\n")
+endfunction()
+
 macro(cmake_pm_add_graphviz)
     find_program(GRAPHVIZ dot)
     if(GRAPHVIZ)
-        add_custom_command(OUTPUT ${CMAKE_BINARY_DIR}/_graphviz
-            COMMAND ${CMAKE_COMMAND} "--graphviz=graphviz/deps.txt" .
-            COMMAND dot -Tsvg graphviz/deps.txt -o deps.svg
-            COMMAND dot -Tpng graphviz/deps.txt -o deps.png
+        option(CMAKE_PM_GRAPHVIZ_ALL "Plot dependency graph as part of ALL" OFF)
+        file(GLOB_RECURSE CMAKE_PM_GRAPHVIZ_INPUTS CONFIGURE_DEPENDS
+            "${PROJECT_SOURCE_DIR}/app/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/src/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/test/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/bench/*CMakeLists.txt"
+            "${PROJECT_SOURCE_DIR}/scripts/*.cmake")
+        cmake_language(DEFER DIRECTORY "${PROJECT_SOURCE_DIR}" CALL cmake_pm_write_target_set)
+        add_custom_command(OUTPUT "${PROJECT_BINARY_DIR}/graphviz/deps.stamp"
+            COMMAND "${CMAKE_COMMAND}" "-DDOT=${GRAPHVIZ}" -P "${PROJECT_SOURCE_DIR}/scripts/graphviz.cmake"
+            DEPENDS
+                "${PROJECT_SOURCE_DIR}/CMakeLists.txt"
+                ${CMAKE_PM_GRAPHVIZ_INPUTS}
+                "${PROJECT_BINARY_DIR}/graphviz/targets.txt"
             COMMENT "Plotting dependencies graph to deps.svg"
-            DEPENDS "${CMAKE_PROJECT_NAME}-app"
-            WORKING_DIRECTORY "${CMAKE_BINARY_DIR}")
-        add_custom_target(graphviz ALL
-            DEPENDS ${CMAKE_BINARY_DIR}/_graphviz)
+            WORKING_DIRECTORY "${PROJECT_BINARY_DIR}")
+        if(CMAKE_PM_GRAPHVIZ_ALL)
+            add_custom_target(graphviz ALL DEPENDS "${PROJECT_BINARY_DIR}/graphviz/deps.stamp")
+        else()
+            add_custom_target(graphviz DEPENDS "${PROJECT_BINARY_DIR}/graphviz/deps.stamp")
+        endif()
     else()
         message(STATUS "GraphViz not found - dependency graph will not be generated")
     endif()
@@ -278,12 +1959,247 @@ macro(cmake_pm_add_compile_commands)
     )
 endmacro()
 
+macro(cmake_pm_add_modules)
+    if(CMAKE_VERSION VERSION_LESS 3.28)
+        message(FATAL_ERROR "C++20 modules need CMake 3.28 or newer")
+    endif()
+    if(CMAKE_GENERATOR MATCHES "Ninja")
+        execute_process(COMMAND "${CMAKE_MAKE_PROGRAM}" --version
+            OUTPUT_VARIABLE CMAKE_PM_NINJA_VERSION
+            OUTPUT_STRIP_TRAILING_WHITESPACE)
+        if(CMAKE_PM_NINJA_VERSION VERSION_LESS 1.11)
+            message(FATAL_ERROR "C++20 modules need Ninja 1.11 or newer, found ${CMAKE_PM_NINJA_VERSION}")
+        endif()
+    elseif(NOT CMAKE_GENERATOR MATCHES "Visual Studio")
+        message(FATAL_ERROR "C++20 modules need Ninja or Visual Studio generator, not ${CMAKE_GENERATOR}")
+    endif()
+    if((CMAKE_CXX_COMPILER_ID STREQUAL "GNU" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 14)
+        OR (CMAKE_CXX_COMPILER_ID STREQUAL "Clang" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 16)
+        OR (CMAKE_CXX_COMPILER_ID STREQUAL "MSVC" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 19.34))
+        message(FATAL_ERROR "${CMAKE_CXX_COMPILER_ID} ${CMAKE_CXX_COMPILER_VERSION} can not scan C++20 modules")
+    endif()
+    set(CMAKE_CXX_SCAN_FOR_MODULES ON)
+endmacro()
+
+macro(cmake_pm_add_allocator ALLOCATOR)
+    set(CMAKE_PM_ALLOCATOR ${ALLOCATOR})
+    set(CMAKE_PM_ALLOCATOR_TARGET "")
+    if(CMAKE_PM_ALLOCATOR STREQUAL "mimalloc")
+        find_package(mimalloc 2.0 QUIET)
+        if(NOT mimalloc_FOUND)
+            CPMAddPackage(
+                NAME mimalloc
+                GITHUB_REPOSITORY microsoft/mimalloc
+                VERSION 2.1.7
+                OPTIONS "MI_BUILD_TESTS OFF" "MI_BUILD_STATIC OFF" "MI_BUILD_OBJECT OFF")
+        endif()
+        # Shared library interposes malloc and operator new of whole process
+        set(CMAKE_PM_ALLOCATOR_TARGET mimalloc)
+    elseif(CMAKE_PM_ALLOCATOR STREQUAL "jemalloc")
+        # jemalloc is built with autotools, so it is taken from the system
+        find_package(PkgConfig QUIET)
+        if(PkgConfig_FOUND)
+            pkg_check_modules(JEMALLOC QUIET IMPORTED_TARGET jemalloc)
+        endif()
+        if(JEMALLOC_FOUND)
+            set(CMAKE_PM_ALLOCATOR_TARGET PkgConfig::JEMALLOC)
+        else()
+            find_library(CMAKE_PM_JEMALLOC_LIBRARY jemalloc)
+            if(NOT CMAKE_PM_JEMALLOC_LIBRARY)
+                message(FATAL_ERROR "jemalloc not found - install it (libjemalloc-dev or jemalloc-devel) or choose other allocator")
+            endif()
+            set(CMAKE_PM_ALLOCATOR_TARGET ${CMAKE_PM_JEMALLOC_LIBRARY})
+        endif()
+    elseif(NOT CMAKE_PM_ALLOCATOR STREQUAL "system")
+        message(FATAL_ERROR "Unknown allocator ${CMAKE_PM_ALLOCATOR} - use system, mimalloc or jemalloc")
+    endif()
+    message(STATUS "Allocator: ${CMAKE_PM_ALLOCATOR}")
+endmacro()
+
+macro(cmake_pm_add_benchmarks)
+    if(EXISTS "${PROJECT_SOURCE_DIR}/bench/CMakeLists.txt")
+        add_subdirectory(bench EXCLUDE_FROM_ALL)
+    endif()
+    # Benchmarks of single libraries (bench/<lib>) join run_benchmarks on their own
+    file(GLOB CMAKE_PM_BENCH_DIRS LIST_DIRECTORIES true "${PROJECT_SOURCE_DIR}/bench/*")
+    foreach(CMAKE_PM_BENCH_DIR ${CMAKE_PM_BENCH_DIRS})
+        if(EXISTS "${CMAKE_PM_BENCH_DIR}/CMakeLists.txt")
+            add_subdirectory("${CMAKE_PM_BENCH_DIR}" EXCLUDE_FROM_ALL)
+        endif()
+    endforeach()
+endmacro()
+
+macro(cmake_pm_add_heap_profiler)
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux" AND EXISTS "${PROJECT_SOURCE_DIR}/tools/heapprof/CMakeLists.txt")
+        add_subdirectory(tools/heapprof EXCLUDE_FROM_ALL)
+    endif()
+endmacro()
+
+# Ninja job pools: compiles use every core, links are limited by memory available at configure time
+macro(cmake_pm_add_job_pools)
+    set(CMAKE_PM_LINK_JOB_MEMORY 4096 CACHE STRING "Memory reserved for one link job, MB")
+    cmake_host_system_information(RESULT CMAKE_PM_CORES QUERY NUMBER_OF_LOGICAL_CORES)
+    cmake_host_system_information(RESULT CMAKE_PM_AVAILABLE_MEMORY QUERY AVAILABLE_PHYSICAL_MEMORY)
+    math(EXPR CMAKE_PM_LINK_JOBS "${CMAKE_PM_AVAILABLE_MEMORY} / ${CMAKE_PM_LINK_JOB_MEMORY}")
+    if(CMAKE_PM_LINK_JOBS LESS 1)
+        set(CMAKE_PM_LINK_JOBS 1)
+    elseif(CMAKE_PM_LINK_JOBS GREATER CMAKE_PM_CORES)
+        set(CMAKE_PM_LINK_JOBS ${CMAKE_PM_CORES})
+    endif()
+    set_property(GLOBAL APPEND PROPERTY JOB_POOLS
+        cmake_pm_compile=${CMAKE_PM_CORES}
+        cmake_pm_link=${CMAKE_PM_LINK_JOBS})
+    set(CMAKE_JOB_POOL_COMPILE cmake_pm_compile)
+    set(CMAKE_JOB_POOL_LINK cmake_pm_link)
+    message(STATUS "Job pools: ${CMAKE_PM_CORES} compile, ${CMAKE_PM_LINK_JOBS} link (${CMAKE_PM_AVAILABLE_MEMORY} MB available)")
+endmacro()
+
+# Shared library exporting only symbols marked with <LIB>_EXPORT of generated <lib>/<lib>_export.h:
+# small dynamic symbol table, calls inside library bound directly instead of through PLT
+macro(cmake_pm_make_shared LIB)
+    include(GenerateExportHeader)
+    generate_export_header(${LIB} EXPORT_FILE_NAME "${PROJECT_BINARY_DIR}/include/${LIB}/${LIB}_export.h")
+    target_include_directories(${LIB} PUBLIC "${PROJECT_BINARY_DIR}/include")
+    set_target_properties(${LIB} PROPERTIES
+        C_VISIBILITY_PRESET hidden
+        CXX_VISIBILITY_PRESET hidden
+        VISIBILITY_INLINES_HIDDEN ON)
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+        target_link_options(${LIB} PUBLIC "LINKER:--as-needed")
+        target_link_options(${LIB} PRIVATE "LINKER:-Bsymbolic-functions")
+    endif()
+endmacro()
+
+# Absolute paths and timestamps do not leak into artifacts, so different checkouts produce identical objects
+# and share compiler cache entries
+macro(cmake_pm_add_reproducible_build)
+    if(CMAKE_C_COMPILER_ID MATCHES "GNU|Clang" AND CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        # The last matching map wins, build tree is usually inside source tree
+        add_compile_options(
+            "-ffile-prefix-map=${PROJECT_SOURCE_DIR}=."
+            "-fdebug-prefix-map=${PROJECT_SOURCE_DIR}=."
+            "-ffile-prefix-map=${PROJECT_BINARY_DIR}=build"
+            "-fdebug-prefix-map=${PROJECT_BINARY_DIR}=build")
+    endif()
+    if(NOT APPLE)
+        foreach(LANG C CXX)
+            set(CMAKE_${LANG}_ARCHIVE_CREATE "<CMAKE_AR> qcD <TARGET> <LINK_FLAGS> <OBJECTS>")
+            set(CMAKE_${LANG}_ARCHIVE_APPEND "<CMAKE_AR> qD <TARGET> <LINK_FLAGS> <OBJECTS>")
+            set(CMAKE_${LANG}_ARCHIVE_FINISH "<CMAKE_RANLIB> -D <TARGET>")
+        endforeach()
+    endif()
+    set(CMAKE_BUILD_RPATH_USE_ORIGIN ON)
+    find_program(CMAKE_PM_CCACHE ccache)
+    if(CMAKE_PM_CCACHE)
+        # Paths below source tree are hashed relative to it
+        foreach(LANG C CXX)
+            set(CMAKE_${LANG}_COMPILER_LAUNCHER
+                ${CMAKE_COMMAND} -E env "CCACHE_BASEDIR=${PROJECT_SOURCE_DIR}" CCACHE_NOHASHDIR=1 ${CMAKE_PM_CCACHE})
+        endforeach()
+    endif()
+endmacro()
+
+# Coverage build type: clang source-based coverage or gcov instrumentation of gcc
+macro(cmake_pm_add_coverage)
+    if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        set(CMAKE_PM_COVERAGE_FLAGS "-fprofile-instr-generate;-fcoverage-mapping")
+    elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        set(CMAKE_PM_COVERAGE_FLAGS "--coverage;-fprofile-update=atomic")
+    endif()
+    add_compile_options("$<$<CONFIG:Coverage>:-O0;-g;${CMAKE_PM_COVERAGE_FLAGS}>")
+    add_link_options("$<$<CONFIG:Coverage>:${CMAKE_PM_COVERAGE_FLAGS}>")
+endmacro()
+
 macro(cmake_pm_add_CPM)
     include(./scripts/CPM.cmake)
     set(CPM_SOURCE_CACHE ~/.cache/CPM)
 endmacro()
 )"""";
 
+const char* const measure_scaling = R""""(#!/bin/bash
+# Measures how generated layout scales: configure, full build, no-op build and rebuild after one source file change.
+# Usage: scripts/measure_scaling.sh [generator] (Ninja by default), every run is appended to .build/scaling.csv
+set -e
+generator=${1:-Ninja}
+source_dir=$( cd "$(dirname "${BASH_SOURCE[0]}")/.." ; pwd -P )
+build_dir="${source_dir}/.build/scaling"
+results="${source_dir}/.build/scaling.csv"
+
+elapsed() {
+    local start end
+    start=$(date +%s.%N)
+    "$@" > /dev/null || exit 1
+    end=$(date +%s.%N)
+    awk -v start="${start}" -v end="${end}" 'BEGIN { printf "%.3f", end - start }'
+}
+
+libraries=$(find "${source_dir}/src" -mindepth 1 -maxdepth 1 -type d | wc -l)
+sources=$(find "${source_dir}/src" "${source_dir}/app" "${source_dir}/test" -name '*.c' -o -name '*.cpp' | wc -l)
+# Implementation file of library in the middle of dependency graph, any library source outside synthetic projects
+middle_file() {
+    sort | awk '{ files[NR] = $0 } END { if (NR > 0) print files[int((NR + 1) / 2)] }'
+}
+changed=$(find "${source_dir}/src" -path '*/file_0.c*' | middle_file)
+if [[ -z "${changed}" ]]
+then
+    changed=$(find "${source_dir}/src" -name '*.c' -o -name '*.cpp' | middle_file)
+fi;
+if [[ -z "${changed}" ]]
+then
+    echo "No library source in ${source_dir}/src to change for one file rebuild" >&2
+    exit 1
+fi;
+
+rm -rf "${build_dir}"
+configure=$(elapsed cmake -S "${source_dir}" -B "${build_dir}" -G "${generator}" -DCMAKE_BUILD_TYPE=Release)
+full=$(elapsed cmake --build "${build_dir}")
+noop=$(elapsed cmake --build "${build_dir}")
+touch "${changed}"
+one_file=$(elapsed cmake --build "${build_dir}")
+
+echo "Libraries:        ${libraries}"
+echo "Source files:     ${sources}"
+echo "Configure:        ${configure} s"
+echo "Full build:       ${full} s"
+echo "No-op build:      ${noop} s"
+echo "One file rebuild: ${one_file} s (${changed#"${source_dir}/"})"
+if [[ ! -f "${results}" ]]
+then
+    echo 'date,generator,libraries,sources,configure,full,noop,one_file' > "${results}"
+fi;
+echo "$(date -u +%Y-%m-%dT%H:%M:%SZ),${generator},${libraries},${sources},${configure},${full},${noop},${one_file}" >> "${results}"
+)"""";
+
+const char* const graphviz = R""""(# Dumps target dependency graph of build tree in working directory,
+# deps.svg and deps.png are rendered only when the dump differs from the last rendered one
+execute_process(COMMAND "${CMAKE_COMMAND}" "--graphviz=graphviz/deps.txt" .
+    OUTPUT_QUIET
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Dependency graph dump failed")
+endif()
+
+file(SHA256 graphviz/deps.txt hash)
+set(rendered "")
+if(EXISTS graphviz/deps.sha256 AND EXISTS deps.svg AND EXISTS deps.png)
+    file(READ graphviz/deps.sha256 rendered)
+endif()
+
+if(hash STREQUAL rendered)
+    message(STATUS "Dependency graph unchanged")
+else()
+    foreach(format svg png)
+        execute_process(COMMAND "${DOT}" -T${format} graphviz/deps.txt -o deps.${format}
+            RESULT_VARIABLE result)
+        if(NOT result EQUAL 0)
+            message(FATAL_ERROR "dot failed to render deps.${format}")
+        endif()
+    endforeach()
+    file(WRITE graphviz/deps.sha256 "${hash}")
+endif()
+file(TOUCH graphviz/deps.stamp)
+)"""";
+
 const char* const cpm = R""""(# CPM.cmake - CMake's missing package manager
 # ===========================================
 # See https://github.com/cpm-cmake/CPM.cmake for usage and update instructions.
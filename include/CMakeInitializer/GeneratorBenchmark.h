@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Generates many projects into scratch directory to measure generator throughput on real filesystem
+class GeneratorBenchmark {
+private:
+    struct Sample {
+        std::chrono::nanoseconds directories;
+        std::chrono::nanoseconds rendering;
+        std::chrono::nanoseconds writes;
+        std::chrono::nanoseconds total;
+    };
+
+    size_t projects;
+    std::filesystem::path scratch_dir;
+    bool own_scratch_dir;
+    std::vector<std::string> generator_arguments;
+
+    std::vector<Sample> samples;
+    size_t files = 0;
+    uintmax_t bytes = 0;
+
+    void report(std::chrono::nanoseconds elapsed) const;
+public:
+    GeneratorBenchmark(int argc, char* argv[]);
+    void run();
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a, enough to fingerprint files and caches (not cryptographic)
+inline uint64_t fnv1a(std::string_view data, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char symbol : data) {
+        hash ^= symbol;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
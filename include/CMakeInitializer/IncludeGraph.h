@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class IncludeGraph {
+private:
+    struct Directive {
+        std::string name;
+        bool quoted;
+    };
+    struct ScannedFile {
+        uintmax_t size = 0;
+        std::vector<Directive> directives;
+    };
+    struct TranslationUnit {
+        std::filesystem::path file;
+        size_t search_paths_id;
+        size_t headers = 0;
+        uintmax_t bytes = 0;
+    };
+    struct SearchPaths {
+        std::vector<std::filesystem::path> quoted;
+        std::vector<std::filesystem::path> angled;
+    };
+
+    std::filesystem::path compile_commands;
+    size_t jobs;
+    size_t top;
+
+    std::vector<SearchPaths> search_paths;
+    std::vector<TranslationUnit> units;
+    std::atomic<size_t> unresolved{0};
+
+    std::mutex scan_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const ScannedFile>> scanned;
+    std::mutex resolve_mutex;
+    std::unordered_map<std::string, std::string> resolved;
+    std::mutex fan_in_mutex;
+    std::unordered_map<std::string, size_t> fan_in;
+
+    void load_compile_commands();
+    std::shared_ptr<const ScannedFile> scan(const std::string& path);
+    std::string resolve(const std::filesystem::path& including_dir, const Directive& directive, size_t search_paths_id);
+    void walk(TranslationUnit& unit);
+    void report() const;
+public:
+    IncludeGraph(int argc, char* argv[]);
+    void run();
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Adds libraries to existing project in one pass: header, source, CMakeLists.txt and test stub of every library
+// are rendered from the same templates as example library of new project
+class LibraryGenerator {
+private:
+    std::filesystem::path project_dir;
+    std::vector<std::string> libraries;
+    std::string root_lists;
+    std::string language;
+    std::string file_extension;
+    int standard = 0;
+    bool modules;
+    bool multiarch;
+    bool shared;
+
+    void detect_language();
+    void enable_modules() const;
+    std::vector<std::pair<std::filesystem::path, std::string>> render(const std::string& library) const;
+    std::vector<std::pair<std::filesystem::path, std::string>> render_multiarch(const std::string& library) const;
+public:
+    LibraryGenerator(int argc, char* argv[]);
+    void run();
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace process {
+
+// Starts command in its own process group, so it can be cancelled together with its children
+pid_t spawn(const std::vector<std::string>& command, const std::string& working_directory = "");
+
+// Same as spawn, with standard input and output redirected to given descriptors (-1 keeps inherited one)
+pid_t spawn_piped(const std::vector<std::string>& command, int input_fd, int output_fd);
+
+// Waits for process to finish and returns its exit code
+int wait(pid_t pid);
+
+// Sends SIGTERM to the whole process group of pid, SIGKILL if it is still running after grace period, and reaps it
+void terminate(pid_t pid, std::chrono::milliseconds grace = std::chrono::seconds(2));
+
+// Non-blocking check: returns true and fills exit_code if process has finished
+bool poll_exit(pid_t pid, int& exit_code);
+
+// Runs command to completion and returns its exit code
+int run(const std::vector<std::string>& command, const std::string& working_directory = "");
+
+// Runs command with empty standard input to completion and returns its standard output (and error output
+// if with_errors is set), throws if it fails
+std::string capture(const std::vector<std::string>& command, const std::string& working_directory = "",
+    bool with_errors = false);
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+
+// Streams ustar archive to file or stdout ("-"), optionally through zstd, without touching disk otherwise
+class TarWriter {
+private:
+    int output_fd = -1;
+    int archive_fd = -1;
+    pid_t compressor = -1;
+    size_t written = 0;
+    std::time_t mtime;
+
+    void write_bytes(const char* data, size_t size);
+    void write_header(const std::string& path, size_t size, int mode, char type);
+public:
+    TarWriter(const std::string& output, bool zstd);
+    TarWriter(const TarWriter&) = delete;
+    TarWriter& operator=(const TarWriter&) = delete;
+    ~TarWriter();
+    void add_directory(const std::string& path);
+    void add_file(const std::string& path, const std::string& content, bool executable);
+    void finish();
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+// Tasks with dependencies: every task starts as soon as all tasks it depends on have finished.
+// Dependencies must be added before their dependents, so insertion order is a valid serial schedule.
+class TaskGraph {
+public:
+    using TaskId = size_t;
+private:
+    struct Node {
+        std::function<void()> task;
+        std::vector<TaskId> dependents;
+        size_t dependencies;
+    };
+
+    std::vector<Node> nodes;
+public:
+    TaskId add(std::function<void()> task, const std::vector<TaskId>& dependencies = {});
+    // Runs tasks in insertion order with one thread, on thread pool otherwise. Rethrows first exception
+    // thrown by a task, tasks depending on it are not run.
+    void run(size_t threads);
+};
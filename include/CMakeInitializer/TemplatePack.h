@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// User templates loaded from disk: every file of pack directory is a template of file with the same relative path.
+// Placeholders {{project_name}}, {{language}}, {{standard}}, {{cmake_version}} and {{file_extension}}
+// are substituted both in paths and in contents.
+class TemplatePack {
+public:
+    enum Variable : uint8_t { ProjectName, Language, Standard, CMakeVersion, FileExtension, VariableCount };
+    using Values = std::array<std::string, VariableCount>;
+
+    struct RenderedFile {
+        std::string path;
+        std::string content;
+        bool executable;
+    };
+private:
+    std::filesystem::path directory;
+    std::filesystem::path cache_path;
+    const char* cache = nullptr;
+    size_t cache_size = 0;
+
+    std::vector<std::filesystem::path> template_files() const;
+    uint64_t signature(const std::vector<std::filesystem::path>& files) const;
+    void build_cache(const std::vector<std::filesystem::path>& files, uint64_t signature) const;
+    bool map_cache(uint64_t signature);
+    void unmap_cache();
+public:
+    explicit TemplatePack(const std::filesystem::path& directory);
+    TemplatePack(const TemplatePack&) = delete;
+    TemplatePack& operator=(const TemplatePack&) = delete;
+    ~TemplatePack();
+    std::vector<RenderedFile> render(const Values& values) const;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    size_t running = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void work();
+public:
+    // Number of workers pool runs for requested count, 0 means all cores
+    static size_t resolve_threads(size_t threads);
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished, rethrows first exception thrown by a task
+    void wait();
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+class Watcher {
+private:
+    std::filesystem::path project_dir;
+    std::filesystem::path build_dir;
+    std::string mode;
+    bool presets;
+    std::string config;
+    bool run_tests;
+    std::chrono::milliseconds debounce;
+    std::vector<std::string> app_arguments;
+
+    int inotify_fd = -1;
+    std::unordered_map<int, std::filesystem::path> watches;
+    std::set<std::filesystem::path> known_files;
+    std::set<std::filesystem::path> changed_files;
+    std::set<std::filesystem::path> untested_files;
+    bool tested_once = false;
+    bool overflowed = false;
+
+    std::vector<std::vector<std::string>> pipeline;
+    pid_t current_job = -1;
+
+    void add_watch_recursive(const std::filesystem::path& directory, bool created);
+    void add_watched_folders();
+    bool read_events();
+    bool structure_changed();
+    void start_pipeline(bool reconfigure);
+    void start_next_job();
+    void cancel_job();
+    std::vector<std::string> run_command() const;
+public:
+    Watcher(int argc, char* argv[]);
+    ~Watcher();
+    void run();
+};
@@ -0,0 +1,209 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <regex>
+#include <sstream>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <CMakeInitializer/AffectedTests.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/Process.h>
+
+namespace options = boost::program_options;
+namespace fs = std::filesystem;
+
+static options::options_description get_description();
+
+AffectedTests::AffectedTests(int argc, char* argv[]) {
+    options::options_description desc = get_description();
+    options::positional_options_description positional;
+    positional.add("ref", 1);
+    options::variables_map map;
+    options::store(options::command_line_parser(argc, argv).options(desc).positional(positional).run(), map);
+    options::notify(map);
+    if (map.count("help")) {
+        std::cout << desc << "\n";
+        throw ExitSignal();
+    }
+    project_dir = fs::absolute(map["dir"].as<std::string>());
+    if (map.count("build")) {
+        build_dir = fs::absolute(map["build"].as<std::string>());
+    } else {
+        build_dir = project_dir / ".build" / "debug";
+    }
+    git_ref = map["ref"].as<std::string>();
+    if (!fs::exists(build_dir / "CMakeCache.txt")) {
+        throw LogicException("build directory must be configured before selecting affected tests");
+    }
+}
+
+AffectedTests::AffectedTests(const fs::path& project_dir, const fs::path& build_dir)
+    : project_dir(project_dir), build_dir(build_dir), git_ref("HEAD") {}
+
+static options::options_description get_description() {
+    options::options_description desc("Print ctest regex for tests affected by changes since git ref");
+    desc.add_options()
+        ("help,h", "Help")
+        ("dir,d", options::value<std::string>()->default_value("."), "Project directory")
+        ("build,b", options::value<std::string>(), "Configured build directory (default .build/debug)")
+        ("ref", options::value<std::string>()->default_value("HEAD"), "Git ref to compare against");
+    return desc;
+}
+
+static fs::file_time_type newest_write_time(const std::vector<fs::path>& files) {
+    fs::file_time_type newest = fs::file_time_type::min();
+    for (const fs::path& file : files) {
+        if (fs::exists(file)) {
+            newest = std::max(newest, fs::last_write_time(file));
+        }
+    }
+    return newest;
+}
+
+// Same target graph cmake_pm_add_graphviz() plots, regenerated only after reconfiguration
+fs::path AffectedTests::dependency_dump() const {
+    fs::path dump = build_dir / "affected" / "deps.dot";
+    fs::file_time_type configured = newest_write_time({
+        build_dir / "CMakeCache.txt", build_dir / "build.ninja", build_dir / "Makefile"
+    });
+    if (!fs::exists(dump) || fs::last_write_time(dump) < configured) {
+        fs::create_directories(dump.parent_path());
+        process::capture({"cmake", "--graphviz=" + dump.string(), "."}, build_dir.string());
+    }
+    return dump;
+}
+
+// Maps each target to targets that link it directly
+std::map<std::string, std::set<std::string>> AffectedTests::load_dependents() const {
+    static const std::regex node_regex(R""""(^\s*"(\w+)"\s*\[\s*label\s*=\s*"([^"]+)")"""");
+    static const std::regex edge_regex(R""""(^\s*"(\w+)"\s*->\s*"(\w+)")"""");
+    std::ifstream dump(dependency_dump());
+    std::map<std::string, std::string> labels;
+    std::vector<std::pair<std::string, std::string>> edges;
+    std::string line;
+    std::smatch match;
+    while (std::getline(dump, line)) {
+        if (std::regex_search(line, match, edge_regex)) {
+            edges.emplace_back(match[1], match[2]);
+        } else if (std::regex_search(line, match, node_regex)) {
+            labels[match[1]] = match[2];
+        }
+    }
+    std::map<std::string, std::set<std::string>> dependents;
+    for (const auto& [dependent, dependency] : edges) {
+        dependents[labels[dependency]].insert(labels[dependent]);
+    }
+    return dependents;
+}
+
+struct TestFile {
+    std::set<std::string> included_libraries;
+    std::set<std::string> suites;
+};
+
+static TestFile scan_test_file(const fs::path& path) {
+    static const std::regex include_regex(R""""(^\s*#\s*include\s*[<"]([^/>"]+)/)"""");
+    static const std::regex import_regex(R""""(^\s*import\s+([\w.]+)\s*;)"""");
+    static const std::regex suite_regex(R""""(^\s*(TEST|TEST_F|TEST_P|TYPED_TEST|TYPED_TEST_P)\s*\(\s*(\w+))"""");
+    std::ifstream file(path);
+    TestFile result;
+    std::string line;
+    std::smatch match;
+    while (std::getline(file, line)) {
+        if (std::regex_search(line, match, include_regex)) {
+            result.included_libraries.insert(match[1]);
+        } else if (std::regex_search(line, match, import_regex)) {
+            result.included_libraries.insert(match[1]);
+        } else if (std::regex_search(line, match, suite_regex)) {
+            result.suites.insert(match[2]);
+        }
+    }
+    return result;
+}
+
+std::string AffectedTests::test_filter(const std::vector<fs::path>& changed_files) const {
+    std::set<std::string> affected_libraries;
+    std::set<fs::path> changed_tests;
+    bool run_all = false;
+    for (const fs::path& changed : changed_files) {
+        fs::path relative = changed.is_absolute() ? changed.lexically_relative(project_dir) : changed;
+        std::vector<std::string> parts(relative.begin(), relative.end());
+        if (parts.empty()) {
+            continue;
+        }
+        // Layout is strictly src/<lib>/... and include/<lib>/...
+        if ((parts[0] == "src" || parts[0] == "include") && parts.size() > 2) {
+            affected_libraries.insert(parts[1]);
+        } else if (parts[0] == "test" && relative.extension() == ".cpp" && relative.filename() != "main.cpp") {
+            changed_tests.insert(project_dir / relative);
+        } else if (parts[0] == "src" || parts[0] == "test" || parts[0] == "scripts" || parts[0] == "CMakeLists.txt") {
+            run_all = true;
+        }
+    }
+    if (run_all) {
+        return ".";
+    }
+    if (affected_libraries.empty() && changed_tests.empty()) {
+        return "";
+    }
+
+    std::map<std::string, std::set<std::string>> dependents = load_dependents();
+    std::vector<std::string> queue(affected_libraries.begin(), affected_libraries.end());
+    while (!queue.empty()) {
+        std::string library = queue.back();
+        queue.pop_back();
+        for (const std::string& dependent : dependents[library]) {
+            if (affected_libraries.insert(dependent).second) {
+                queue.push_back(dependent);
+            }
+        }
+    }
+
+    std::set<std::string> suites;
+    if (fs::is_directory(project_dir / "test")) {
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(project_dir / "test")) {
+            if (entry.path().extension() != ".cpp" || entry.path().filename() == "main.cpp") {
+                continue;
+            }
+            TestFile test = scan_test_file(entry.path());
+            // Executable of test/<lib> directory is linked with its library
+            fs::path relative = entry.path().lexically_relative(project_dir / "test");
+            if (std::distance(relative.begin(), relative.end()) > 1) {
+                test.included_libraries.insert(relative.begin()->string());
+            }
+            bool affected = changed_tests.count(entry.path()) > 0;
+            for (const std::string& library : test.included_libraries) {
+                affected = affected || affected_libraries.count(library) > 0;
+            }
+            if (affected) {
+                suites.insert(test.suites.begin(), test.suites.end());
+            }
+        }
+    }
+    if (suites.empty()) {
+        return "";
+    }
+    // gtest_discover_tests names tests Suite.Name, parametrized ones Prefix/Suite.Name/Param
+    return "(^|/)(" + boost::join(suites, "|") + ")\\.";
+}
+
+std::vector<fs::path> AffectedTests::changed_files() const {
+    std::string output = process::capture({"git", "diff", "--name-only", "--relative", git_ref}, project_dir.string());
+    output += process::capture({"git", "ls-files", "--others", "--exclude-standard"}, project_dir.string());
+    std::vector<fs::path> files;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty()) {
+            files.emplace_back(line);
+        }
+    }
+    return files;
+}
+
+void AffectedTests::run() {
+    std::string filter = test_filter(changed_files());
+    if (!filter.empty()) {
+        std::cout << filter << "\n";
+    }
+}
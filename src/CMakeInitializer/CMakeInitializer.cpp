@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
 #include <fstream>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <filesystem>
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
@@ -7,12 +12,45 @@
 #include <CMakeInitializer/CMakeInitializer.h>
 #include <CMakeInitializer/Errors.h>
 #include <CMakeInitializer/FileContents.h>
+#include <CMakeInitializer/TemplatePack.h>
+#include <CMakeInitializer/TarWriter.h>
+#include <CMakeInitializer/TaskGraph.h>
+#include <CMakeInitializer/ThreadPool.h>
 
 namespace options = boost::program_options;
 namespace fs = std::filesystem;
 
 static options::options_description get_description();
 
+// libs=N,files=M,deps=K, omitted keys keep defaults
+static void parse_synthetic_spec(const std::string& spec, size_t& libs, size_t& files, size_t& deps) {
+    libs = 100;
+    files = 10;
+    deps = 3;
+    std::vector<std::string> items;
+    boost::split(items, spec, boost::is_any_of(","));
+    for (const std::string& item : items) {
+        size_t separator = item.find('=');
+        std::string key = item.substr(0, separator);
+        size_t value = 0;
+        if (separator == std::string::npos || std::sscanf(item.c_str() + separator + 1, "%zu", &value) != 1) {
+            throw LogicException("synthetic project must be specified as libs=N,files=M,deps=K");
+        }
+        if (key == "libs") {
+            libs = value;
+        } else if (key == "files") {
+            files = value;
+        } else if (key == "deps") {
+            deps = value;
+        } else {
+            throw LogicException("synthetic project must be specified as libs=N,files=M,deps=K");
+        }
+    }
+    if (libs == 0 || files == 0) {
+        throw LogicException("synthetic project needs at least one library and file");
+    }
+}
+
 CMakeInitializer::CMakeInitializer(int argc, char* argv[]) {
     options::options_description desc = get_description();
     options::variables_map map;
@@ -43,26 +81,153 @@ CMakeInitializer::CMakeInitializer(int argc, char* argv[]) {
     }
     if (map.count("name")) {
         project_name = map["name"].as<std::string>();
+        project_dir = project_name;
     } else {
         throw LogicException("project name must be specified");
     }
+    if (map.count("templates")) {
+        template_pack = map["templates"].as<std::string>();
+    }
+    update = map.count("update") > 0;
+    if (update && !fs::is_directory(project_dir)) {
+        throw LogicException("project to update does not exist");
+    }
+    if (map.count("output-archive")) {
+        output_archive = map["output-archive"].as<std::string>();
+    }
+    zstd = map.count("zstd") > 0;
+    quiet = map.count("quiet") > 0;
+    jobs = ThreadPool::resolve_threads(map["jobs"].as<size_t>());
+    if (zstd && output_archive.empty()) {
+        throw LogicException("zstd compression needs --output-archive");
+    }
+    if (update && !output_archive.empty()) {
+        throw LogicException("archive can not be used to update project");
+    }
+    tracing = map.count("with-tracing") > 0;
+    if (tracing && language != "CXX") {
+        throw LogicException("tracing is available only for C++");
+    }
+    allocator = map["allocator"].as<std::string>();
+    boost::to_lower(allocator);
+    if (allocator != "system" && allocator != "mimalloc" && allocator != "jemalloc") {
+        throw LogicException("allocator must be specified as system/mimalloc/jemalloc");
+    }
+    multi_config = map.count("multi-config") > 0;
+    std::string library_type = map["library-type"].as<std::string>();
+    boost::to_lower(library_type);
+    if (library_type != "static" && library_type != "shared") {
+        throw LogicException("library type must be specified as static/shared");
+    }
+    shared = library_type == "shared";
+    if (map.count("synthetic")) {
+        parse_synthetic_spec(map["synthetic"].as<std::string>(), synthetic_libs, synthetic_files, synthetic_deps);
+    }
+    modules = map.count("modules") > 0;
+    if (modules && shared) {
+        throw LogicException("shared libraries can not be combined with modules");
+    }
+    if (modules) {
+        if (language != "CXX" || standard < 20) {
+            throw LogicException("modules are available only for C++20 and newer");
+        }
+        // FILE_SET CXX_MODULES is scanned since CMake 3.28
+        int major = 0, minor = 0;
+        if (std::sscanf(cmake_version.c_str(), "%d.%d", &major, &minor) != 2 || major < 3 || (major == 3 && minor < 28)) {
+            cmake_version = "3.28";
+        }
+    }
 }
 
+// Generation as task graph: directories and rendering steps are independent, writes need both.
+// Every rendering step fills its own list and lists are merged in fixed order,
+// so generated project does not depend on number of jobs or scheduling.
 void CMakeInitializer::initialize() {
-    create_folder_structure();
-    populate_root_folder();
-    populate_app_folder();
-    populate_include_folder();
-    populate_src_folder();
-    populate_docs_folder();
-    populate_test_folder();
-    populate_scripts_folder();
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    clock::time_point rendered;
+    TaskGraph graph;
+    TaskGraph::TaskId folders = graph.add([this] {
+        clock::time_point phase_start = clock::now();
+        create_folder_structure();
+        stats.directories = clock::now() - phase_start;
+    });
+
+    std::vector<std::function<void(Files&)>> steps = {
+        [this](Files& output) { populate_root_folder(output); },
+        [this](Files& output) { populate_app_folder(output); },
+        [this](Files& output) { populate_include_folder(output); },
+        [this](Files& output) { populate_src_folder(output); },
+        [this](Files& output) { populate_docs_folder(output); },
+        [this](Files& output) { populate_test_folder(output); },
+        [this](Files& output) { populate_bench_folder(output); },
+        [this](Files& output) { populate_tools_folder(output); }
+    };
+    std::vector<std::vector<size_t>> dependencies = synthetic_dependencies();
+    for (size_t library = 0; library < synthetic_libs; ++library) {
+        steps.push_back([this, &dependencies, library](Files& output) {
+            populate_synthetic_library(library, dependencies[library], output);
+        });
+    }
+    steps.push_back([this](Files& output) { populate_scripts_folder(output); });
+    steps.push_back([this](Files& output) { populate_from_template_pack(output); });
+    std::vector<Files> outputs(steps.size());
+    std::vector<TaskGraph::TaskId> rendering;
+    for (size_t step = 0; step < steps.size(); ++step) {
+        rendering.push_back(graph.add([&steps, &outputs, step] { steps[step](outputs[step]); }));
+    }
+    TaskGraph::TaskId merged = graph.add([this, &outputs, &rendered] {
+        merge_files(outputs);
+        rendered = clock::now();
+    }, rendering);
+
+    // Files are dealt to writers round-robin, one writer per pool thread
+    size_t writers = ThreadPool::resolve_threads(jobs);
+    std::vector<UpdateAction> actions;
+    if (update) {
+        TaskGraph::TaskId prepared = graph.add([this, &actions] { actions.resize(files.size()); }, {merged});
+        for (size_t writer = 0; writer < writers; ++writer) {
+            graph.add([this, &actions, writer, writers] {
+                for (size_t file = writer; file < files.size(); file += writers) {
+                    actions[file] = update_file(files[file]);
+                }
+            }, {folders, prepared});
+        }
+    } else if (!output_archive.empty()) {
+        // Archive holds directory entries too, so it waits for folder structure
+        graph.add([this] { write_archive(); }, {folders, merged});
+    } else {
+        for (size_t writer = 0; writer < writers; ++writer) {
+            graph.add([this, writer, writers] {
+                for (size_t file = writer; file < files.size(); file += writers) {
+                    write_file(files[file]);
+                }
+            }, {folders, merged});
+        }
+    }
+    graph.run(jobs);
+    // Phases overlap when run in parallel, directories then count into rendering
+    stats.rendering = rendered - start - (jobs == 1 ? stats.directories : clock::duration::zero());
+    stats.writes = clock::now() - rendered;
+
+    if (update) {
+        report_update(actions);
+        return;
+    }
     const char* result_output_format = R""""(Project creation successfull:
 Project name: %1%
 Language: %2%%3%
 CMake version: %4%
 )"""";
-    std::cout << boost::format(result_output_format) % project_name % language % standard % cmake_version;
+    // Standard output may be the archive itself
+    std::ostream& summary = output_archive.empty() ? std::cout : std::cerr;
+    if (!quiet) {
+        summary << boost::format(result_output_format) % project_name % language % standard % cmake_version;
+    }
+}
+
+const CMakeInitializer::Statistics& CMakeInitializer::statistics() const {
+    return stats;
 }
 
 static options::options_description get_description() {
@@ -72,82 +237,365 @@ static options::options_description get_description() {
         ("version,v", options::value<std::string>()->default_value("3.27"), "Minimal CMake version")
         ("name,n", options::value<std::string>(), "Project name")
         ("language,l", options::value<std::string>()->default_value("cpp"), "Language (c or cpp)")
-        ("standard,s", options::value<int>()->default_value(20), "Language standard");
+        ("standard,s", options::value<int>()->default_value(20), "Language standard")
+        ("modules", "Generate C++20 module interface units instead of headers")
+        ("with-tracing", "Add tracing library writing Chrome trace of scoped zones")
+        ("allocator", options::value<std::string>()->default_value("system"),
+            "Allocator linked into app and tests (system, mimalloc or jemalloc)")
+        ("library-type", options::value<std::string>()->default_value("static"),
+            "Type of example library and libraries added by newlib (static or shared)")
+        ("multi-config", "Build profiles in one Ninja Multi-Config tree")
+        ("synthetic", options::value<std::string>(), "Add libs=N,files=M,deps=K synthetic libraries for scaling tests")
+        ("templates,t", options::value<std::string>(), "Template pack directory overriding built-in files")
+        ("update,u", "Regenerate existing project, writing only files that changed")
+        ("output-archive,o", options::value<std::string>(), "Stream project as tar archive to file (- for stdout)")
+        ("zstd", "Compress archive with zstd")
+        ("quiet,q", "Do not print project summary")
+        ("jobs,j", options::value<size_t>()->default_value(1), "Generator threads (0 - all cores)")
+        ("bench", options::value<size_t>(), "Benchmark generator on N random projects made with other options");
     return desc;
 }
 
 void CMakeInitializer::create_folder_structure() {
-    fs::create_directories(project_name + "/src");
-    fs::create_directories(project_name + "/scripts");
-    fs::create_directories(project_name + "/include");
-    fs::create_directories(project_name + "/docs");
-    fs::create_directories(project_name + "/app");
-    fs::create_directories(project_name + "/test");
+    directories = {"src", "scripts", "include", "docs", "app", "test"};
+    if (!output_archive.empty()) {
+        return;
+    }
+    for (const std::string& directory : directories) {
+        fs::create_directories(project_dir / directory);
+    }
 }
 
-static void create_file(const std::string& file_name, const std::string& file_content) {
+// Macro calls enabling optional features, placed right after CPM in root CMakeLists.txt
+std::string CMakeInitializer::root_features() const {
+    std::string features;
+    if (modules) {
+        features += "cmake_pm_add_modules()\n";
+    }
+    if (allocator != "system") {
+        features += (boost::format("cmake_pm_add_allocator(%1%)\n") % allocator).str();
+    }
+    return features;
+}
+
+void CMakeInitializer::add_file(Files& output, const std::string& path, const std::string& content,
+        FileKind kind, bool executable) {
+    output.push_back({path, content, kind, executable});
+}
+
+// Pack files (rendered last) replace built-in ones with the same path and take over their kind,
+// so update keeps user edited files whether they come from the pack or not
+void CMakeInitializer::merge_files(std::vector<Files>& outputs) {
+    Files& pack = outputs.back();
+    for (GeneratedFile& pack_file : pack) {
+        for (const Files& output : outputs) {
+            auto same_path = [&pack_file](const GeneratedFile& file) { return file.path == pack_file.path; };
+            auto built_in = std::find_if(output.begin(), output.end(), same_path);
+            if (&output != &pack && built_in != output.end()) {
+                pack_file.kind = built_in->kind;
+            }
+        }
+    }
+    for (Files& output : outputs) {
+        for (GeneratedFile& file : output) {
+            auto same_path = [&file](const GeneratedFile& pack_file) { return pack_file.path == file.path; };
+            if (&output == &pack || std::none_of(pack.begin(), pack.end(), same_path)) {
+                files.push_back(std::move(file));
+            }
+        }
+    }
+    stats.files = files.size();
+    for (const GeneratedFile& file : files) {
+        stats.bytes += file.content.size();
+    }
+}
+
+static void create_file(const fs::path& file_name, const std::string& file_content) {
     std::ofstream file = std::ofstream();
     file.open(file_name);
     file << file_content;
     file.close();
 }
 
-void CMakeInitializer::populate_root_folder() {
-    create_file(project_name + "/CMakeLists.txt",
+// Temporary file in the same directory and rename: readers never observe partially written file
+static void replace_file(const fs::path& file_name, const std::string& file_content, bool executable) {
+    fs::path temporary = file_name;
+    temporary += ".cmake-init-tmp";
+    create_file(temporary, file_content);
+    if (fs::exists(file_name)) {
+        fs::permissions(temporary, fs::status(file_name).permissions());
+    }
+    if (executable) {
+        fs::permissions(temporary, fs::perms::owner_exec, fs::perm_options::add);
+    }
+    fs::rename(temporary, file_name);
+}
+
+static bool same_content(const fs::path& file_name, const std::string& content) {
+    if (fs::file_size(file_name) != content.size()) {
+        return false;
+    }
+    std::ifstream file(file_name, std::ios::binary);
+    std::stringstream on_disk;
+    on_disk << file.rdbuf();
+    return on_disk.str() == content;
+}
+
+void CMakeInitializer::write_file(const GeneratedFile& file) const {
+    fs::path path = project_dir / file.path;
+    fs::create_directories(path.parent_path());
+    create_file(path, file.content);
+    if (file.executable) {
+        fs::permissions(path, fs::perms::owner_exec, fs::perm_options::add);
+    }
+}
+
+// Only bytes that differ reach the disk, so mtimes of unchanged files (and Ninja, ccache, CMake regeneration) stay intact
+CMakeInitializer::UpdateAction CMakeInitializer::update_file(const GeneratedFile& file) const {
+    fs::path path = project_dir / file.path;
+    if (!fs::exists(path)) {
+        fs::create_directories(path.parent_path());
+        replace_file(path, file.content, file.executable);
+        return UpdateAction::Created;
+    } else if (file.kind == FileKind::Scaffold) {
+        return UpdateAction::Kept;
+    } else if (same_content(path, file.content)) {
+        return UpdateAction::Unchanged;
+    }
+    replace_file(path, file.content, file.executable);
+    return UpdateAction::Updated;
+}
+
+// Printed after all writers finished, in order of files
+void CMakeInitializer::report_update(const std::vector<UpdateAction>& actions) const {
+    size_t created = 0, updated = 0, unchanged = 0, kept = 0;
+    std::cout << boost::format("Project update successfull: %1%\n") % project_name;
+    for (size_t file = 0; file < files.size(); ++file) {
+        if (actions[file] == UpdateAction::Created) {
+            std::cout << "    created  " << files[file].path << "\n";
+            ++created;
+        } else if (actions[file] == UpdateAction::Updated) {
+            std::cout << "    updated  " << files[file].path << "\n";
+            ++updated;
+        } else if (actions[file] == UpdateAction::Unchanged) {
+            ++unchanged;
+        } else {
+            ++kept;
+        }
+    }
+    std::cout << boost::format("%1% created, %2% updated, %3% unchanged, %4% user sources kept\n")
+        % created % updated % unchanged % kept;
+}
+
+void CMakeInitializer::write_archive() {
+    std::set<fs::path> archive_directories = {""};
+    for (const std::string& directory : directories) {
+        archive_directories.insert(directory);
+    }
+    for (const GeneratedFile& file : files) {
+        for (fs::path parent = fs::path(file.path).parent_path(); !parent.empty(); parent = parent.parent_path()) {
+            archive_directories.insert(parent);
+        }
+    }
+    TarWriter archive(output_archive, zstd);
+    fs::path root = fs::path(project_name).filename();
+    for (const fs::path& directory : archive_directories) {
+        archive.add_directory((root / directory).lexically_normal().string());
+    }
+    for (const GeneratedFile& file : files) {
+        archive.add_file((root / file.path).string(), file.content, file.executable);
+    }
+    archive.finish();
+}
+
+void CMakeInitializer::populate_root_folder(Files& output) const {
+    add_file(output, "CMakeLists.txt",
         (boost::format(contents::root::cmake_file)
             % cmake_version
             % project_name
             % language
-            % standard).str());
-    create_file(project_name + "/.gitignore", contents::root::gitignore_file);
-    create_file(project_name + "/cmake-pm",
+            % standard
+            % root_features()).str(), FileKind::Scaffold);
+    add_file(output, "CMakePresets.json",
+        multi_config ? contents::root::presets_multi_config_file : contents::root::presets_file);
+    add_file(output, ".gitignore", std::string(contents::root::gitignore_file) + (tracing ? "/trace.json\n" : ""));
+    add_file(output, "cmake-pm",
         (boost::format(contents::root::manager_file)
             % project_name
-            % file_extension).str());
-    fs::permissions(project_name + "/cmake-pm", fs::perms::owner_exec, fs::perm_options::add);
+            % (multi_config ? "true" : "false")
+            % (shared ? "shared" : "static")).str(), FileKind::Managed, true);
 }
 
-void CMakeInitializer::populate_scripts_folder() {
-    create_file(project_name + "/scripts/CPM.cmake", contents::scripts::cpm);
-    create_file(project_name + "/scripts/macros.cmake", contents::scripts::macros);
+void CMakeInitializer::populate_scripts_folder(Files& output) const {
+    if (synthetic_libs > 0) {
+        add_file(output, "scripts/measure_scaling.sh", contents::scripts::measure_scaling, FileKind::Managed, true);
+    }
+    add_file(output, "scripts/CPM.cmake", contents::scripts::cpm);
+    add_file(output, "scripts/macros.cmake", contents::scripts::macros);
+    add_file(output, "scripts/graphviz.cmake", contents::scripts::graphviz);
 }
 
-void CMakeInitializer::populate_app_folder() {
+void CMakeInitializer::populate_app_folder(Files& output) const {
     if (file_extension == ".c") {
-        create_file(project_name + "/app/app" + file_extension, contents::app::c_file);
+        add_file(output, "app/app" + file_extension, contents::app::c_file, FileKind::Scaffold);
+    } else if (modules) {
+        add_file(output, "app/app" + file_extension, contents::app::cpp_modules_file, FileKind::Scaffold);
+    } else if (tracing) {
+        add_file(output, "app/app" + file_extension, contents::app::cpp_tracing_file, FileKind::Scaffold);
     } else {
-        create_file(project_name + "/app/app" + file_extension, contents::app::cpp_file);
+        add_file(output, "app/app" + file_extension, contents::app::cpp_file, FileKind::Scaffold);
     }
-    create_file(project_name + "/app/CMakeLists.txt",
+    add_file(output, "app/CMakeLists.txt",
         (boost::format(contents::app::cmake_file) % file_extension).str());
 }
 
-void CMakeInitializer::populate_include_folder() {
-    fs::create_directories(project_name + "/include/example_lib");
-    create_file(project_name + "/include/example_lib/example_lib.h", contents::include::header_file);
+void CMakeInitializer::populate_include_folder(Files& output) const {
+    if (tracing) {
+        add_file(output, "include/tracing/tracing.h", contents::include::tracing_header_file);
+    }
+    if (modules) {
+        return;
+    }
+    add_file(output, "include/example_lib/example_lib.h",
+        shared ? (boost::format(contents::include::shared_header_file) % "example_lib" % "EXAMPLE_LIB").str()
+            : contents::include::header_file, FileKind::Scaffold);
+}
+
+void CMakeInitializer::populate_src_folder(Files& output) const {
+    add_file(output, "src/CMakeLists.txt", contents::src::cmake_file);
+    if (tracing) {
+        add_file(output, "src/tracing/tracing.cpp", contents::src::tracing_file);
+        add_file(output, "src/tracing/CMakeLists.txt", contents::src::tracing_cmake_file);
+    }
+    if (modules) {
+        add_file(output, "src/example_lib/example_lib.cppm",
+            (boost::format(contents::src::example_module_file) % "example_lib").str(), FileKind::Scaffold);
+        add_file(output, "src/example_lib/CMakeLists.txt",
+            (boost::format(contents::src::example_module_cmake_file) % "example_lib").str(), FileKind::Scaffold);
+        return;
+    }
+    add_file(output, "src/example_lib/example_lib" + file_extension,
+        (boost::format(contents::src::example_lib_file) % "example_lib").str(), FileKind::Scaffold);
+    add_file(output, "src/example_lib/CMakeLists.txt",
+        (boost::format(contents::src::example_lib_cmake_file)
+            % "example_lib"
+            % file_extension
+            % (shared ? " SHARED" : "")
+            % (shared ? "cmake_pm_make_shared(${LIB_NAME})\n" : "")).str(), FileKind::Scaffold);
+}
+
+void CMakeInitializer::populate_docs_folder(Files& output) const {
+    add_file(output, "docs/CMakeLists.txt", contents::docs::cmake_file);
+    add_file(output, "docs/mainpage.md",
+        (boost::format(contents::docs::mainpage_file) % project_name).str(), FileKind::Scaffold);
+}
+
+void CMakeInitializer::populate_test_folder(Files& output) const {
+    add_file(output, "test/CMakeLists.txt", contents::test::cmake_file);
+    add_file(output, "test/main.cpp", contents::test::main_file);
+    if (tracing) {
+        add_file(output, "test/tracing/tracing_test.cpp", contents::test::tracing_file, FileKind::Scaffold);
+    }
+    const char* test_file = file_extension == ".c" ? contents::test::example_lib_c_file
+        : modules ? contents::test::example_lib_module_file
+        : contents::test::example_lib_cpp_file;
+    add_file(output, "test/example_lib/example_lib_test.cpp",
+        (boost::format(test_file) % "example_lib" % "ExampleTests").str(), FileKind::Scaffold);
+}
+
+// Allocation churn benchmark built twice, with system and with selected allocator
+void CMakeInitializer::populate_bench_folder(Files& output) const {
+    if (allocator == "system") {
+        return;
+    }
+    add_file(output, "bench/CMakeLists.txt", contents::bench::cmake_file, FileKind::Scaffold);
+    add_file(output, "bench/allocation_churn.cpp", contents::bench::allocation_churn_file, FileKind::Scaffold);
+}
+
+// Heap profiler preloaded by cmake-pm run --heap
+void CMakeInitializer::populate_tools_folder(Files& output) const {
+    add_file(output, "tools/heapprof/CMakeLists.txt", contents::tools::heapprof_cmake_file);
+    add_file(output, "tools/heapprof/heapprof.cpp", contents::tools::heapprof_file);
 }
 
-void CMakeInitializer::populate_src_folder() {
-    fs::create_directories(project_name + "/src/example_lib");
-    create_file(project_name + "/src/CMakeLists.txt", contents::src::cmake_file);
-    create_file(project_name + "/src/example_lib/example_lib" + file_extension, contents::src::example_lib_file);
-    create_file(project_name + "/src/example_lib/CMakeLists.txt",
-        (boost::format(contents::src::example_lib_cmake_file) % file_extension).str());
+// Zero padded, so that directory globbing keeps libraries in order
+std::string CMakeInitializer::synthetic_library_name(size_t library) const {
+    size_t width = std::max<size_t>(4, std::to_string(synthetic_libs - 1).size());
+    std::string number = std::to_string(library);
+    return "lib_" + std::string(width - number.size(), '0') + number;
 }
 
-void CMakeInitializer::populate_docs_folder() {
-    create_file(project_name + "/docs/CMakeLists.txt", contents::docs::cmake_file);
-    create_file(project_name + "/docs/mainpage.md",
-        (boost::format(contents::docs::mainpage_file) % project_name).str());
+// Libraries depend on randomly chosen earlier ones (fixed seed: same spec gives same project)
+std::vector<std::vector<size_t>> CMakeInitializer::synthetic_dependencies() const {
+    std::vector<std::vector<size_t>> dependencies(synthetic_libs);
+    std::mt19937 random(0);
+    for (size_t library = 0; library < synthetic_libs; ++library) {
+        std::vector<size_t> candidates(library);
+        for (size_t candidate = 0; candidate < library; ++candidate) {
+            candidates[candidate] = candidate;
+        }
+        std::shuffle(candidates.begin(), candidates.end(), random);
+        candidates.resize(std::min(synthetic_deps, candidates.size()));
+        std::sort(candidates.begin(), candidates.end());
+        dependencies[library] = candidates;
+    }
+    return dependencies;
 }
 
-void CMakeInitializer::populate_test_folder() {
-    create_file(project_name + "/test/CMakeLists.txt", contents::test::cmake_file);
-    create_file(project_name + "/test/main.cpp", contents::test::main_file);
+// Every file references first file of each dependency, every library gets its own test file
+void CMakeInitializer::populate_synthetic_library(size_t library, const std::vector<size_t>& dependencies,
+        Files& output) const {
+    std::string name = synthetic_library_name(library);
+    std::string includes, functions, libraries;
+    for (size_t dependency : dependencies) {
+        includes += "#include <" + synthetic_library_name(dependency) + "/file_0.h>\n";
+        functions += (functions.empty() ? "" : ", ") + synthetic_library_name(dependency) + "_file_0";
+        libraries += " " + synthetic_library_name(dependency);
+    }
+    std::string test_includes, assertions;
+    for (size_t file = 0; file < synthetic_files; ++file) {
+        add_file(output, (boost::format("include/%1%/file_%2%.h") % name % file).str(),
+            (boost::format(contents::include::synthetic_header_file) % name % file).str(), FileKind::Scaffold);
+        std::string source = dependencies.empty()
+            ? (boost::format(contents::src::synthetic_leaf_file) % name % file).str()
+            : (boost::format(contents::src::synthetic_file) % name % file % includes % functions % dependencies.size()).str();
+        add_file(output, (boost::format("src/%1%/file_%2%%3%") % name % file % file_extension).str(), source,
+            FileKind::Scaffold);
+        test_includes += (boost::format("#include <%1%/file_%2%.h>\n") % name % file).str();
+        assertions += (boost::format("    EXPECT_EQ(%1%, %2%_file_%3%(5));\n") % (5 + file) % name % file).str();
+    }
+    add_file(output, "src/" + name + "/CMakeLists.txt",
+        (boost::format(contents::src::synthetic_cmake_file)
+            % name
+            % file_extension
+            % (libraries.empty() ? "" : "target_link_libraries(${LIB_NAME} PUBLIC" + libraries + ")\n")).str(),
+        FileKind::Scaffold);
     if (file_extension == ".c") {
-        create_file(project_name + "/test/exampletest.cpp", contents::test::example_lib_c_file);
-    } else {
-        create_file(project_name + "/test/exampletest.cpp", contents::test::example_lib_cpp_file);
+        test_includes = "extern \"C\" {\n" + test_includes + "}\n";
     }
+    add_file(output, "test/" + name + "/" + name + "_test.cpp",
+        (boost::format(contents::test::synthetic_file)
+            % ("Lib" + name.substr(4) + "Tests")
+            % test_includes
+            % assertions).str(), FileKind::Scaffold);
 }
 
+void CMakeInitializer::populate_from_template_pack(Files& output) const {
+    if (template_pack.empty()) {
+        return;
+    }
+    TemplatePack pack(template_pack);
+    TemplatePack::Values values;
+    values[TemplatePack::ProjectName] = project_name;
+    values[TemplatePack::Language] = language;
+    values[TemplatePack::Standard] = std::to_string(standard);
+    values[TemplatePack::CMakeVersion] = cmake_version;
+    values[TemplatePack::FileExtension] = file_extension;
+    for (TemplatePack::RenderedFile& file : pack.render(values)) {
+        fs::path relative = fs::path(file.path).lexically_normal();
+        if (relative.empty() || relative.is_absolute() || *relative.begin() == "..") {
+            throw LogicException("template pack file escapes project directory");
+        }
+        add_file(output, relative.string(), file.content, FileKind::Scaffold, file.executable);
+    }
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <unistd.h>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <CMakeInitializer/GeneratorBenchmark.h>
+#include <CMakeInitializer/CMakeInitializer.h>
+#include <CMakeInitializer/Errors.h>
+
+namespace options = boost::program_options;
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+static options::options_description get_description();
+
+GeneratorBenchmark::GeneratorBenchmark(int argc, char* argv[]) {
+    options::options_description desc = get_description();
+    options::parsed_options parsed = options::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+    options::variables_map map;
+    options::store(parsed, map);
+    options::notify(map);
+    if (map.count("help")) {
+        std::cout << desc << "\n";
+        throw ExitSignal();
+    }
+    if (!map.count("bench") || map["bench"].as<size_t>() == 0) {
+        throw LogicException("number of benchmarked projects must be positive");
+    }
+    projects = map["bench"].as<size_t>();
+    if (map.count("dir")) {
+        scratch_dir = fs::absolute(map["dir"].as<std::string>());
+    } else {
+        scratch_dir = fs::temp_directory_path() / ("cmake-init-bench-" + std::to_string(getpid()));
+    }
+    own_scratch_dir = !fs::exists(scratch_dir);
+    // Everything else describes generated projects
+    generator_arguments = options::collect_unrecognized(parsed.options, options::include_positional);
+}
+
+static options::options_description get_description() {
+    options::options_description desc("Generate projects with random names and report generator throughput"
+        " (other options are passed to generator)");
+    desc.add_options()
+        ("help,h", "Help")
+        ("bench", options::value<size_t>(), "Number of generated projects")
+        ("dir", options::value<std::string>(), "Scratch directory (temporary directory by default)");
+    return desc;
+}
+
+void GeneratorBenchmark::run() {
+    fs::create_directories(scratch_dir);
+    fs::path previous_dir = fs::current_path();
+    fs::current_path(scratch_dir);
+    std::vector<std::string> names;
+    auto clean_up = [&]() {
+        for (const std::string& name : names) {
+            fs::remove_all(name);
+        }
+        fs::current_path(previous_dir);
+        if (own_scratch_dir) {
+            fs::remove_all(scratch_dir);
+        }
+    };
+
+    std::mt19937_64 random(std::random_device{}());
+    clock_type::time_point begin = clock_type::now();
+    try {
+        for (size_t i = 0; i < projects; ++i) {
+            names.push_back((boost::format("bench_%016x") % random()).str());
+            std::vector<std::string> arguments = {"cmake-init", "--quiet", "--name", names.back()};
+            arguments.insert(arguments.end(), generator_arguments.begin(), generator_arguments.end());
+            std::vector<char*> argv;
+            for (std::string& argument : arguments) {
+                argv.push_back(argument.data());
+            }
+
+            clock_type::time_point start = clock_type::now();
+            CMakeInitializer initializer = CMakeInitializer(argv.size(), argv.data());
+            initializer.initialize();
+            std::chrono::nanoseconds total = clock_type::now() - start;
+
+            const CMakeInitializer::Statistics& statistics = initializer.statistics();
+            samples.push_back({statistics.directories, statistics.rendering, statistics.writes, total});
+            files += statistics.files;
+            bytes += statistics.bytes;
+        }
+    } catch (...) {
+        clean_up();
+        throw;
+    }
+    std::chrono::nanoseconds elapsed = clock_type::now() - begin;
+    clean_up();
+    report(elapsed);
+}
+
+// Nearest-rank percentile
+static double percentile_ms(std::vector<std::chrono::nanoseconds> values, double percent) {
+    std::sort(values.begin(), values.end());
+    size_t rank = std::max<size_t>(1, std::ceil(percent / 100 * values.size()));
+    return std::chrono::duration<double, std::milli>(values[rank - 1]).count();
+}
+
+void GeneratorBenchmark::report(std::chrono::nanoseconds elapsed) const {
+    using Phase = std::chrono::nanoseconds Sample::*;
+    const std::pair<const char*, Phase> phases[] = {
+        {"directories", &Sample::directories},
+        {"rendering", &Sample::rendering},
+        {"writes", &Sample::writes},
+        {"total", &Sample::total}
+    };
+    std::cout << boost::format("Generated %1% projects in %2% (%3% files, %4% bytes each)\n")
+        % projects % scratch_dir.string() % (files / projects) % (bytes / projects);
+    std::cout << boost::format("%-12s %10s %10s %10s\n") % "phase" % "p50 ms" % "p95 ms" % "p99 ms";
+    for (const auto& [name, phase] : phases) {
+        std::vector<std::chrono::nanoseconds> values;
+        for (const Sample& sample : samples) {
+            values.push_back(sample.*phase);
+        }
+        std::cout << boost::format("%-12s %10.3f %10.3f %10.3f\n") % name
+            % percentile_ms(values, 50) % percentile_ms(values, 95) % percentile_ms(values, 99);
+    }
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << boost::format("Throughput: %.0f files/s, %.2f MB/s\n") % (files / seconds) % (bytes / seconds / 1e6);
+}
@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string.hpp>
+#include <CMakeInitializer/IncludeGraph.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/Process.h>
+#include <CMakeInitializer/ThreadPool.h>
+
+namespace options = boost::program_options;
+namespace fs = std::filesystem;
+
+static options::options_description get_description();
+
+IncludeGraph::IncludeGraph(int argc, char* argv[]) {
+    options::options_description desc = get_description();
+    options::variables_map map;
+    options::store(options::parse_command_line(argc, argv, desc), map);
+    options::notify(map);
+    if (map.count("help")) {
+        std::cout << desc << "\n";
+        throw ExitSignal();
+    }
+    if (map.count("compile-commands")) {
+        compile_commands = map["compile-commands"].as<std::string>();
+    } else {
+        compile_commands = fs::path(map["dir"].as<std::string>()) / "compile_commands.json";
+    }
+    jobs = ThreadPool::resolve_threads(map["jobs"].as<size_t>());
+    top = map["top"].as<size_t>();
+    if (!fs::exists(compile_commands)) {
+        throw LogicException("compile_commands.json not found, configure project first");
+    }
+}
+
+static options::options_description get_description() {
+    options::options_description desc("Static include graph cost analysis");
+    desc.add_options()
+        ("help,h", "Help")
+        ("dir,d", options::value<std::string>()->default_value("."), "Project directory")
+        ("compile-commands,c", options::value<std::string>(), "Path to compile_commands.json")
+        ("jobs,j", options::value<size_t>()->default_value(0), "Scanner threads (0 - all cores)")
+        ("top,t", options::value<size_t>()->default_value(20), "Number of headers and units to list");
+    return desc;
+}
+
+namespace {
+
+// Just enough JSON to read compile_commands.json: strings, arrays and objects, other values are skipped
+struct JsonValue {
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& [name, value] : object) {
+            if (name == key) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+private:
+    const char* ptr;
+    const char* end;
+
+    void skip_spaces() {
+        while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) {
+            ++ptr;
+        }
+    }
+
+    void expect(char symbol) {
+        skip_spaces();
+        if (ptr >= end || *ptr != symbol) {
+            throw LogicException("malformed compile_commands.json");
+        }
+        ++ptr;
+    }
+
+    std::string parse_string() {
+        expect('"');
+        std::string result;
+        while (ptr < end && *ptr != '"') {
+            if (*ptr == '\\' && ptr + 1 < end) {
+                ++ptr;
+                switch (*ptr) {
+                    case 'n': result += '\n'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': result += '?'; ptr += std::min<ptrdiff_t>(4, end - ptr - 1); break;
+                    default: result += *ptr;
+                }
+            } else {
+                result += *ptr;
+            }
+            ++ptr;
+        }
+        expect('"');
+        return result;
+    }
+public:
+    explicit JsonParser(const std::string& text) : ptr(text.data()), end(text.data() + text.size()) {}
+
+    JsonValue parse() {
+        JsonValue value;
+        skip_spaces();
+        if (ptr >= end) {
+            throw LogicException("malformed compile_commands.json");
+        }
+        if (*ptr == '"') {
+            value.string = parse_string();
+        } else if (*ptr == '[') {
+            ++ptr;
+            skip_spaces();
+            while (ptr < end && *ptr != ']') {
+                value.array.push_back(parse());
+                skip_spaces();
+                if (ptr < end && *ptr == ',') {
+                    ++ptr;
+                }
+                skip_spaces();
+            }
+            expect(']');
+        } else if (*ptr == '{') {
+            ++ptr;
+            skip_spaces();
+            while (ptr < end && *ptr != '}') {
+                std::string key = parse_string();
+                expect(':');
+                value.object.emplace_back(key, parse());
+                skip_spaces();
+                if (ptr < end && *ptr == ',') {
+                    ++ptr;
+                }
+                skip_spaces();
+            }
+            expect('}');
+        } else {
+            while (ptr < end && *ptr != ',' && *ptr != ']' && *ptr != '}') {
+                ++ptr;
+            }
+        }
+        return value;
+    }
+};
+
+}
+
+static std::vector<std::string> split_command(const std::string& command) {
+    std::vector<std::string> arguments;
+    std::string current;
+    bool in_argument = false;
+    char quote = 0;
+    for (size_t i = 0; i < command.size(); ++i) {
+        char symbol = command[i];
+        if (quote) {
+            if (symbol == quote) {
+                quote = 0;
+            } else if (symbol == '\\' && quote == '"' && i + 1 < command.size()) {
+                current += command[++i];
+            } else {
+                current += symbol;
+            }
+        } else if (symbol == '"' || symbol == '\'') {
+            quote = symbol;
+            in_argument = true;
+        } else if (symbol == '\\' && i + 1 < command.size()) {
+            current += command[++i];
+            in_argument = true;
+        } else if (std::isspace(static_cast<unsigned char>(symbol))) {
+            if (in_argument) {
+                arguments.push_back(current);
+                current.clear();
+                in_argument = false;
+            }
+        } else {
+            current += symbol;
+            in_argument = true;
+        }
+    }
+    if (in_argument) {
+        arguments.push_back(current);
+    }
+    return arguments;
+}
+
+// Compiler launchers (ccache, cmake -E env VAR=value ... of reproducible builds) precede the real compiler
+static size_t compiler_index(const std::vector<std::string>& arguments) {
+    static const std::set<std::string> launchers = {"ccache", "sccache", "distcc", "icecc", "buildcache"};
+    size_t index = 0;
+    while (index < arguments.size()) {
+        std::string program = fs::path(arguments[index]).filename().string();
+        if (launchers.count(program)) {
+            ++index;
+        } else if ((program == "cmake" || program == "cmake.exe") && index + 2 < arguments.size()
+                && arguments[index + 1] == "-E" && arguments[index + 2] == "env") {
+            index += 3;
+            while (index < arguments.size() && (arguments[index].find('=') != std::string::npos
+                    || boost::starts_with(arguments[index], "--"))) {
+                ++index;
+            }
+        } else if (program == "env") {
+            ++index;
+            while (index < arguments.size() && arguments[index].find('=') != std::string::npos) {
+                ++index;
+            }
+        } else {
+            break;
+        }
+    }
+    return index;
+}
+
+// Asks compiler for its builtin search list, the part of the graph compile commands never mention
+static std::vector<fs::path> compiler_search_paths(const std::string& compiler, const std::string& language) {
+    std::string output;
+    try {
+        output = process::capture({compiler, "-E", "-x", language, "-", "-v"}, "", true);
+    } catch (std::exception&) {
+        return {};
+    }
+    std::vector<fs::path> paths;
+    std::istringstream lines(output);
+    std::string line;
+    bool in_list = false;
+    while (std::getline(lines, line)) {
+        if (boost::starts_with(line, "#include <...> search starts here:")) {
+            in_list = true;
+        } else if (boost::starts_with(line, "End of search list.")) {
+            in_list = false;
+        } else if (in_list) {
+            boost::trim(line);
+            boost::erase_last(line, " (framework directory)");
+            paths.emplace_back(line);
+        }
+    }
+    return paths;
+}
+
+void IncludeGraph::load_compile_commands() {
+    std::ifstream file(compile_commands);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    JsonValue root = JsonParser(buffer.str()).parse();
+
+    std::map<std::string, std::vector<fs::path>> system_paths;
+    std::map<std::string, size_t> search_paths_ids;
+    for (const JsonValue& entry : root.array) {
+        const JsonValue* directory = entry.find("directory");
+        const JsonValue* file_name = entry.find("file");
+        if (!directory || !file_name) {
+            continue;
+        }
+        std::vector<std::string> arguments;
+        if (const JsonValue* list = entry.find("arguments")) {
+            for (const JsonValue& argument : list->array) {
+                arguments.push_back(argument.string);
+            }
+        } else if (const JsonValue* command = entry.find("command")) {
+            arguments = split_command(command->string);
+        }
+        size_t compiler = compiler_index(arguments);
+        if (compiler >= arguments.size()) {
+            continue;
+        }
+        fs::path base = directory->string;
+        fs::path source = base / file_name->string;
+        std::string language = source.extension() == ".c" ? "c" : "c++";
+
+        std::vector<fs::path> quote_dirs, include_dirs, system_dirs;
+        for (size_t i = compiler + 1; i < arguments.size(); ++i) {
+            const std::string& argument = arguments[i];
+            for (auto [flag, target] : {
+                    std::pair<const char*, std::vector<fs::path>*>{"-iquote", &quote_dirs},
+                    {"-isystem", &system_dirs}, {"-idirafter", &system_dirs}, {"-I", &include_dirs}}) {
+                if (!boost::starts_with(argument, flag)) {
+                    continue;
+                }
+                std::string value = argument.substr(std::strlen(flag));
+                if (value.empty() && i + 1 < arguments.size()) {
+                    value = arguments[++i];
+                }
+                target->push_back((base / value).lexically_normal());
+                break;
+            }
+        }
+        std::string compiler_key = arguments[compiler] + " " + language;
+        if (!system_paths.count(compiler_key)) {
+            system_paths[compiler_key] = compiler_search_paths(arguments[compiler], language);
+        }
+        SearchPaths paths;
+        paths.angled = include_dirs;
+        paths.angled.insert(paths.angled.end(), system_dirs.begin(), system_dirs.end());
+        paths.angled.insert(paths.angled.end(), system_paths[compiler_key].begin(), system_paths[compiler_key].end());
+        paths.quoted = quote_dirs;
+        paths.quoted.insert(paths.quoted.end(), paths.angled.begin(), paths.angled.end());
+
+        std::string key;
+        for (const fs::path& path : paths.quoted) {
+            key += path.string() + "\n";
+        }
+        auto [id, inserted] = search_paths_ids.try_emplace(key, search_paths.size());
+        if (inserted) {
+            search_paths.push_back(paths);
+        }
+        units.push_back({source.lexically_normal(), id->second});
+    }
+}
+
+static void scan_directives(const char* data, size_t size, std::vector<std::pair<std::string, bool>>& result) {
+    const char* ptr = data;
+    const char* end = data + size;
+    while (ptr < end) {
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+            ++ptr;
+        }
+        if (ptr < end && *ptr == '#') {
+            ++ptr;
+            while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+                ++ptr;
+            }
+            const char keyword[] = "include";
+            if (end - ptr > 7 && std::equal(keyword, keyword + 7, ptr)) {
+                ptr += 7;
+                while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+                    ++ptr;
+                }
+                if (ptr < end && (*ptr == '"' || *ptr == '<')) {
+                    char closing = *ptr == '"' ? '"' : '>';
+                    bool quoted = *ptr == '"';
+                    const char* name = ++ptr;
+                    while (ptr < end && *ptr != closing && *ptr != '\n') {
+                        ++ptr;
+                    }
+                    if (ptr < end && *ptr == closing) {
+                        result.emplace_back(std::string(name, ptr), quoted);
+                    }
+                }
+            }
+        }
+        ptr = static_cast<const char*>(std::memchr(ptr, '\n', end - ptr));
+        ptr = ptr ? ptr + 1 : end;
+    }
+}
+
+std::shared_ptr<const IncludeGraph::ScannedFile> IncludeGraph::scan(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(scan_mutex);
+        auto found = scanned.find(path);
+        if (found != scanned.end()) {
+            return found->second;
+        }
+    }
+    auto file = std::make_shared<ScannedFile>();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info = {};
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+        file->size = info.st_size;
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            std::vector<std::pair<std::string, bool>> directives;
+            scan_directives(static_cast<const char*>(data), info.st_size, directives);
+            for (auto& [name, quoted] : directives) {
+                file->directives.push_back({std::move(name), quoted});
+            }
+            munmap(data, info.st_size);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    std::lock_guard<std::mutex> lock(scan_mutex);
+    return scanned.try_emplace(path, file).first->second;
+}
+
+std::string IncludeGraph::resolve(const fs::path& including_dir, const Directive& directive, size_t search_paths_id) {
+    std::string key = std::to_string(search_paths_id) + "|" + (directive.quoted ? including_dir.string() : "")
+        + "|" + directive.name;
+    {
+        std::lock_guard<std::mutex> lock(resolve_mutex);
+        auto found = resolved.find(key);
+        if (found != resolved.end()) {
+            return found->second;
+        }
+    }
+    std::vector<fs::path> candidates;
+    const SearchPaths& paths = search_paths[search_paths_id];
+    if (directive.quoted) {
+        candidates.push_back(including_dir);
+        candidates.insert(candidates.end(), paths.quoted.begin(), paths.quoted.end());
+    } else {
+        candidates = paths.angled;
+    }
+    std::string result;
+    for (const fs::path& directory : candidates) {
+        fs::path candidate = directory / directive.name;
+        std::error_code error;
+        if (fs::is_regular_file(candidate, error)) {
+            result = candidate.lexically_normal().string();
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(resolve_mutex);
+    return resolved.try_emplace(key, result).first->second;
+}
+
+// Every header is counted once per unit, as if it had include guards
+void IncludeGraph::walk(TranslationUnit& unit) {
+    std::unordered_set<std::string> visited;
+    std::vector<std::string> stack = {unit.file.string()};
+    unit.bytes = scan(unit.file.string())->size;
+    while (!stack.empty()) {
+        fs::path current = stack.back();
+        stack.pop_back();
+        std::shared_ptr<const ScannedFile> file = scan(current.string());
+        for (const Directive& directive : file->directives) {
+            std::string header = resolve(current.parent_path(), directive, unit.search_paths_id);
+            if (header.empty()) {
+                ++unresolved;
+                continue;
+            }
+            if (visited.insert(header).second) {
+                unit.headers += 1;
+                unit.bytes += scan(header)->size;
+                stack.push_back(header);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(fan_in_mutex);
+    for (const std::string& header : visited) {
+        fan_in[header] += 1;
+    }
+}
+
+void IncludeGraph::report() const {
+    struct HeaderCost {
+        std::string path;
+        size_t fan_in;
+        uintmax_t size;
+    };
+    std::vector<HeaderCost> headers;
+    for (const auto& [path, count] : fan_in) {
+        headers.push_back({path, count, scanned.at(path)->size});
+    }
+    std::sort(headers.begin(), headers.end(), [](const HeaderCost& a, const HeaderCost& b) {
+        return a.fan_in * a.size > b.fan_in * b.size;
+    });
+    std::vector<const TranslationUnit*> heaviest;
+    for (const TranslationUnit& unit : units) {
+        heaviest.push_back(&unit);
+    }
+    std::sort(heaviest.begin(), heaviest.end(), [](const TranslationUnit* a, const TranslationUnit* b) {
+        return a->bytes > b->bytes;
+    });
+
+    std::cout << boost::format("Translation units: %1%, headers: %2%, unresolved includes: %3%\n\n")
+        % units.size() % headers.size() % unresolved.load();
+    std::cout << "Headers by fan-in x size (candidates for forward declarations or PCH):\n";
+    std::cout << boost::format("%10s %8s %10s  %s\n") % "cost, MB" % "fan-in" % "size, KB" % "header";
+    for (size_t i = 0; i < std::min(top, headers.size()); ++i) {
+        std::cout << boost::format("%10.2f %8d %10.1f  %s\n")
+            % (headers[i].fan_in * headers[i].size / 1048576.0)
+            % headers[i].fan_in
+            % (headers[i].size / 1024.0)
+            % headers[i].path;
+    }
+    std::cout << "\nHeaviest translation units:\n";
+    std::cout << boost::format("%10s %10s  %s\n") % "headers" % "bytes, KB" % "unit";
+    for (size_t i = 0; i < std::min(top, heaviest.size()); ++i) {
+        std::cout << boost::format("%10d %10.1f  %s\n")
+            % heaviest[i]->headers
+            % (heaviest[i]->bytes / 1024.0)
+            % heaviest[i]->file.string();
+    }
+}
+
+void IncludeGraph::run() {
+    load_compile_commands();
+    ThreadPool pool(jobs);
+    for (TranslationUnit& unit : units) {
+        pool.submit([this, &unit] { walk(unit); });
+    }
+    pool.wait();
+    report();
+}
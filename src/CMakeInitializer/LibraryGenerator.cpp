@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <regex>
+#include <set>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string.hpp>
+#include <CMakeInitializer/LibraryGenerator.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/FileContents.h>
+
+namespace options = boost::program_options;
+namespace fs = std::filesystem;
+
+static options::options_description get_description();
+
+// math_utils -> MathUtilsTests
+static std::string test_suite(const std::string& library) {
+    std::vector<std::string> words;
+    boost::split(words, library, boost::is_any_of("_"));
+    std::string suite;
+    for (std::string& word : words) {
+        if (!word.empty()) {
+            word[0] = std::toupper(static_cast<unsigned char>(word[0]));
+            suite += word;
+        }
+    }
+    return suite + "Tests";
+}
+
+LibraryGenerator::LibraryGenerator(int argc, char* argv[]) {
+    options::options_description desc = get_description();
+    options::positional_options_description positional;
+    positional.add("project", 1);
+    positional.add("libraries", -1);
+    options::variables_map map;
+    options::store(options::command_line_parser(argc, argv).options(desc).positional(positional).run(), map);
+    options::notify(map);
+    if (map.count("help")) {
+        std::cout << desc << "\n";
+        throw ExitSignal();
+    }
+    project_dir = fs::absolute(map["project"].as<std::string>());
+    if (!map.count("libraries")) {
+        throw LogicException("at least one library name must be specified");
+    }
+    libraries = map["libraries"].as<std::vector<std::string>>();
+    static const std::regex identifier_regex("[A-Za-z_][A-Za-z0-9_]*");
+    std::set<std::string> unique_libraries;
+    for (const std::string& library : libraries) {
+        // Library name is also C identifier in export macro and module name
+        if (!std::regex_match(library, identifier_regex)) {
+            throw LogicException("library name must be a valid identifier");
+        }
+        if (!unique_libraries.insert(library).second) {
+            throw LogicException("library names must be unique");
+        }
+    }
+    std::string library_type = map["library-type"].as<std::string>();
+    boost::to_lower(library_type);
+    if (map.count("shared")) {
+        library_type = "shared";
+    } else if (map.count("static")) {
+        library_type = "static";
+    }
+    if (library_type != "static" && library_type != "shared") {
+        throw LogicException("library type must be specified as static/shared");
+    }
+    shared = library_type == "shared";
+    modules = map.count("modules") > 0;
+    multiarch = map.count("multiarch") > 0;
+    if (modules && shared) {
+        throw LogicException("shared libraries can not be combined with modules");
+    }
+    if (modules && multiarch) {
+        throw LogicException("multiarch libraries can not be module libraries");
+    }
+    detect_language();
+    if (modules && (language != "CXX" || standard < 20)) {
+        throw LogicException("modules are available only for C++20 and newer");
+    }
+}
+
+static options::options_description get_description() {
+    options::options_description desc("Add libraries to existing project: cmake-init newlib <project> <library...>");
+    desc.add_options()
+        ("help,h", "Help")
+        ("project", options::value<std::string>()->default_value("."), "Project directory")
+        ("libraries", options::value<std::vector<std::string>>(), "Names of new libraries")
+        ("library-type", options::value<std::string>()->default_value("static"), "Type of libraries (static or shared)")
+        ("shared", "Shared libraries, overrides library type")
+        ("static", "Static libraries, overrides library type")
+        ("modules", "Module interface units instead of headers")
+        ("multiarch", "Kernel built for every x86-64 level (v2, v3, v4) with runtime dispatch, test and benchmark");
+    return desc;
+}
+
+// Language and standard are taken from root CMakeLists.txt written by initializer
+void LibraryGenerator::detect_language() {
+    std::ifstream file(project_dir / "CMakeLists.txt");
+    if (!file) {
+        throw LogicException("project directory has no CMakeLists.txt");
+    }
+    root_lists = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::string& content = root_lists;
+    static const std::regex language_regex(R""""(set\(PROJECT_LANGUAGE (C|CXX)\))"""");
+    static const std::regex standard_regex(R""""(set\(CMAKE_(C|CXX)_STANDARD (\d+)\))"""");
+    std::smatch match;
+    if (!std::regex_search(content, match, language_regex)) {
+        throw LogicException("project language not found in CMakeLists.txt");
+    }
+    language = match[1];
+    file_extension = language == "C" ? ".c" : ".cpp";
+    if (std::regex_search(content, match, standard_regex)) {
+        standard = std::stoi(match[2]);
+    }
+}
+
+std::vector<std::pair<fs::path, std::string>> LibraryGenerator::render(const std::string& library) const {
+    std::vector<std::pair<fs::path, std::string>> files;
+    fs::path test_path = fs::path("test") / library / (library + "_test.cpp");
+    if (modules) {
+        files.emplace_back(fs::path("src") / library / (library + ".cppm"),
+            (boost::format(contents::src::example_module_file) % library).str());
+        files.emplace_back(fs::path("src") / library / "CMakeLists.txt",
+            (boost::format(contents::src::example_module_cmake_file) % library).str());
+        files.emplace_back(test_path,
+            (boost::format(contents::test::example_lib_module_file) % library % test_suite(library)).str());
+        return files;
+    }
+    if (multiarch) {
+        return render_multiarch(library);
+    }
+    files.emplace_back(fs::path("include") / library / (library + ".h"),
+        shared ? (boost::format(contents::include::shared_header_file) % library % boost::to_upper_copy(library)).str()
+            : contents::include::header_file);
+    files.emplace_back(fs::path("src") / library / (library + file_extension),
+        (boost::format(contents::src::example_lib_file) % library).str());
+    files.emplace_back(fs::path("src") / library / "CMakeLists.txt",
+        (boost::format(contents::src::example_lib_cmake_file)
+            % library
+            % file_extension
+            % (shared ? " SHARED" : "")
+            % (shared ? "cmake_pm_make_shared(${LIB_NAME})\n" : "")).str());
+    files.emplace_back(test_path,
+        (boost::format(language == "C" ? contents::test::example_lib_c_file : contents::test::example_lib_cpp_file)
+            % library
+            % test_suite(library)).str());
+    return files;
+}
+
+// Dispatcher picks kernel variant with __builtin_cpu_supports instead of ifunc or target_clones,
+// so that test and benchmark can force every variant
+std::vector<std::pair<fs::path, std::string>> LibraryGenerator::render_multiarch(const std::string& library) const {
+    std::vector<std::pair<fs::path, std::string>> files;
+    std::string export_macro = boost::to_upper_copy(library) + "_EXPORT ";
+    files.emplace_back(fs::path("include") / library / (library + ".h"),
+        (boost::format(contents::include::multiarch_header_file)
+            % library
+            % (shared ? "#include <" + library + "/" + library + "_export.h>\n" : "")
+            % (shared ? export_macro : "")).str());
+    files.emplace_back(fs::path("src") / library / (library + file_extension),
+        (boost::format(contents::src::multiarch_file) % library % file_extension).str());
+    files.emplace_back(fs::path("src") / library / "variants" / ("kernel" + file_extension),
+        contents::src::multiarch_kernel_file);
+    files.emplace_back(fs::path("src") / library / "CMakeLists.txt",
+        (boost::format(contents::src::multiarch_cmake_file)
+            % library
+            % file_extension
+            % (shared ? " SHARED" : "")
+            % (shared ? "cmake_pm_make_shared(${LIB_NAME})\n" : "")).str());
+    files.emplace_back(fs::path("test") / library / (library + "_test.cpp"),
+        (boost::format(contents::test::multiarch_file) % library % test_suite(library)).str());
+    files.emplace_back(fs::path("bench") / library / "CMakeLists.txt",
+        (boost::format(contents::bench::multiarch_cmake_file) % library).str());
+    files.emplace_back(fs::path("bench") / library / (library + "_bench.cpp"),
+        (boost::format(contents::bench::multiarch_file) % library).str());
+    return files;
+}
+
+// FILE_SET CXX_MODULES is scanned since CMake 3.28, so module libraries raise minimal version of root CMakeLists.txt
+// and enable module checks of cmake_pm_add_modules() if project was created without them
+void LibraryGenerator::enable_modules() const {
+    static const std::regex version_regex(R""""(cmake_minimum_required\(VERSION (\d+)\.(\d+)[^)]*\))"""");
+    std::string content = root_lists;
+    std::smatch match;
+    if (std::regex_search(content, match, version_regex)) {
+        int major = std::stoi(match[1]), minor = std::stoi(match[2]);
+        if (major < 3 || (major == 3 && minor < 28)) {
+            content.replace(match.position(0), match.length(0), "cmake_minimum_required(VERSION 3.28)");
+        }
+    }
+    size_t libraries = content.find("set(LIBRARY_LIST \"\")");
+    if (content.find("cmake_pm_add_modules()") == std::string::npos && libraries != std::string::npos) {
+        content.insert(libraries, "cmake_pm_add_modules()\n");
+    }
+    if (content != root_lists) {
+        std::ofstream(project_dir / "CMakeLists.txt") << content;
+    }
+}
+
+// Every library is checked before anything is written, so failed batch leaves project untouched
+void LibraryGenerator::run() {
+    for (const std::string& library : libraries) {
+        if (fs::exists(project_dir / "include" / library) || fs::exists(project_dir / "src" / library)
+                || fs::exists(project_dir / "test" / library) || fs::exists(project_dir / "bench" / library)) {
+            throw LogicException("include, src, test or bench directory already has similarly named library");
+        }
+    }
+    std::vector<std::pair<fs::path, std::string>> files;
+    for (const std::string& library : libraries) {
+        std::vector<std::pair<fs::path, std::string>> library_files = render(library);
+        std::move(library_files.begin(), library_files.end(), std::back_inserter(files));
+    }
+    for (const auto& [path, content] : files) {
+        fs::create_directories((project_dir / path).parent_path());
+        std::ofstream(project_dir / path) << content;
+    }
+    if (modules) {
+        enable_modules();
+    }
+    for (const std::string& library : libraries) {
+        std::cout << boost::format(modules ? "Generated new module library %1%\n"
+            : multiarch ? "Generated new multiarch library %1%\n" : "Generated new library %1%\n") % library;
+    }
+}
@@ -0,0 +1,136 @@
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <CMakeInitializer/Process.h>
+
+namespace process {
+
+static pid_t spawn_with_io(const std::vector<std::string>& command,
+        const std::string& working_directory, int input_fd, int output_fd, int error_fd = -1) {
+    std::vector<char*> argv;
+    for (const std::string& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::system_error(errno, std::generic_category(), "fork");
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        // Ignored SIGPIPE would be inherited through exec
+        signal(SIGPIPE, SIG_DFL);
+        if (input_fd >= 0) {
+            dup2(input_fd, STDIN_FILENO);
+        }
+        if (output_fd >= 0) {
+            dup2(output_fd, STDOUT_FILENO);
+        }
+        if (error_fd >= 0) {
+            dup2(error_fd, STDERR_FILENO);
+        }
+        if (!working_directory.empty() && chdir(working_directory.c_str()) != 0) {
+            _exit(127);
+        }
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    setpgid(pid, pid);
+    return pid;
+}
+
+pid_t spawn(const std::vector<std::string>& command, const std::string& working_directory) {
+    return spawn_with_io(command, working_directory, -1, -1);
+}
+
+pid_t spawn_piped(const std::vector<std::string>& command, int input_fd, int output_fd) {
+    return spawn_with_io(command, "", input_fd, output_fd);
+}
+
+// Process group ignoring SIGTERM for the whole grace period is killed
+void terminate(pid_t pid, std::chrono::milliseconds grace) {
+    kill(-pid, SIGTERM);
+    auto deadline = std::chrono::steady_clock::now() + grace;
+    int status = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        pid_t result = waitpid(pid, &status, WNOHANG);
+        if (result == pid || (result < 0 && errno != EINTR)) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    kill(-pid, SIGKILL);
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+}
+
+static int wait_for(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "waitpid");
+        }
+    }
+    return status;
+}
+
+static int decode_status(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return 128 + WTERMSIG(status);
+}
+
+bool poll_exit(pid_t pid, int& exit_code) {
+    int status = 0;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if (result != pid) {
+        return false;
+    }
+    exit_code = decode_status(status);
+    return true;
+}
+
+int wait(pid_t pid) {
+    return decode_status(wait_for(pid));
+}
+
+int run(const std::vector<std::string>& command, const std::string& working_directory) {
+    return decode_status(wait_for(spawn(command, working_directory)));
+}
+
+std::string capture(const std::vector<std::string>& command, const std::string& working_directory, bool with_errors) {
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    pid_t pid = spawn_with_io(command, working_directory, null_fd, pipe_fds[1], with_errors ? pipe_fds[1] : -1);
+    if (null_fd >= 0) {
+        close(null_fd);
+    }
+    close(pipe_fds[1]);
+    std::string output;
+    char buffer[4096];
+    ssize_t length;
+    while ((length = read(pipe_fds[0], buffer, sizeof(buffer))) != 0) {
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length < 0) {
+            break;
+        }
+        output.append(buffer, length);
+    }
+    close(pipe_fds[0]);
+    if (decode_status(wait_for(pid)) != 0) {
+        throw std::runtime_error("command failed: " + command.front());
+    }
+    return output;
+}
+
+}
@@ -0,0 +1,147 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <CMakeInitializer/TarWriter.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/Process.h>
+
+static const size_t block_size = 512;
+static const size_t record_size = 20 * block_size;
+
+// Exit code 127 is what spawned child returns when exec fails
+static LogicException compressor_error(int exit_code) {
+    if (exit_code == 127) {
+        return LogicException("zstd not found, install it or drop --zstd");
+    }
+    return LogicException("zstd failed to compress archive");
+}
+
+TarWriter::TarWriter(const std::string& output, bool zstd) {
+    // SOURCE_DATE_EPOCH keeps archives of same project byte-identical
+    const char* epoch = std::getenv("SOURCE_DATE_EPOCH");
+    mtime = epoch ? std::strtoll(epoch, nullptr, 10) : std::time(nullptr);
+    if (output == "-") {
+        output_fd = STDOUT_FILENO;
+    } else {
+        output_fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (output_fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + output);
+        }
+    }
+    archive_fd = output_fd;
+    // Reader going away (zstd or stdout consumer) is reported as EPIPE write error instead of killing us
+    std::signal(SIGPIPE, SIG_IGN);
+    if (zstd) {
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+            throw std::system_error(errno, std::generic_category(), "pipe");
+        }
+        compressor = process::spawn_piped({"zstd", "-q", "-c"}, pipe_fds[0], output_fd);
+        close(pipe_fds[0]);
+        archive_fd = pipe_fds[1];
+    }
+}
+
+TarWriter::~TarWriter() {
+    if (archive_fd >= 0 && archive_fd != output_fd) {
+        close(archive_fd);
+    }
+    if (compressor > 0) {
+        process::wait(compressor);
+    }
+    if (output_fd >= 0 && output_fd != STDOUT_FILENO) {
+        close(output_fd);
+    }
+}
+
+void TarWriter::write_bytes(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t result = write(archive_fd, data, size);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE && compressor > 0) {
+                // Compressor stopped reading, its exit code tells why
+                close(archive_fd);
+                archive_fd = -1;
+                int exit_code = process::wait(compressor);
+                compressor = -1;
+                throw compressor_error(exit_code);
+            }
+            throw std::system_error(errno, std::generic_category(), "write archive");
+        }
+        data += result;
+        size -= result;
+        written += result;
+    }
+}
+
+void TarWriter::write_header(const std::string& path, size_t size, int mode, char type) {
+    char header[block_size] = {};
+    std::string name = path;
+    std::string prefix;
+    if (name.size() > 100) {
+        size_t split = name.rfind('/', 155);
+        if (split == std::string::npos || name.size() - split - 1 > 100) {
+            throw LogicException("path is too long for tar archive");
+        }
+        prefix = name.substr(0, split);
+        name = name.substr(split + 1);
+    }
+    std::memcpy(header, name.data(), name.size());
+    std::snprintf(header + 100, 8, "%07o", mode);
+    std::snprintf(header + 108, 8, "%07o", 0);
+    std::snprintf(header + 116, 8, "%07o", 0);
+    std::snprintf(header + 124, 12, "%011zo", size);
+    std::snprintf(header + 136, 12, "%011llo", static_cast<unsigned long long>(mtime));
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    std::memcpy(header + 345, prefix.data(), prefix.size());
+    // Checksum is computed with its own field filled with spaces
+    std::memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (size_t i = 0; i < block_size; ++i) {
+        checksum += static_cast<unsigned char>(header[i]);
+    }
+    std::snprintf(header + 148, 8, "%06o", checksum);
+    write_bytes(header, block_size);
+}
+
+void TarWriter::add_directory(const std::string& path) {
+    write_header(path.back() == '/' ? path : path + "/", 0, 0755, '5');
+}
+
+void TarWriter::add_file(const std::string& path, const std::string& content, bool executable) {
+    write_header(path, content.size(), executable ? 0755 : 0644, '0');
+    write_bytes(content.data(), content.size());
+    static const char padding[block_size] = {};
+    size_t tail = content.size() % block_size;
+    if (tail) {
+        write_bytes(padding, block_size - tail);
+    }
+}
+
+// End of archive is two zero blocks, padded to full record like tar(1) does
+void TarWriter::finish() {
+    static const char zeros[record_size] = {};
+    write_bytes(zeros, 2 * block_size);
+    write_bytes(zeros, (record_size - written % record_size) % record_size);
+    if (archive_fd != output_fd) {
+        close(archive_fd);
+        archive_fd = -1;
+    }
+    if (compressor > 0) {
+        int exit_code = process::wait(compressor);
+        compressor = -1;
+        if (exit_code != 0) {
+            throw compressor_error(exit_code);
+        }
+    }
+}
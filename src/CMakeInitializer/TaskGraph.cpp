@@ -0,0 +1,44 @@
+#include <atomic>
+#include <memory>
+#include <CMakeInitializer/TaskGraph.h>
+#include <CMakeInitializer/ThreadPool.h>
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> task, const std::vector<TaskId>& dependencies) {
+    TaskId id = nodes.size();
+    for (TaskId dependency : dependencies) {
+        nodes[dependency].dependents.push_back(id);
+    }
+    nodes.push_back({std::move(task), {}, dependencies.size()});
+    return id;
+}
+
+void TaskGraph::run(size_t threads) {
+    if (threads <= 1) {
+        for (Node& node : nodes) {
+            node.task();
+        }
+        return;
+    }
+    std::unique_ptr<std::atomic<size_t>[]> remaining(new std::atomic<size_t>[nodes.size()]);
+    for (TaskId id = 0; id < nodes.size(); ++id) {
+        remaining[id] = nodes[id].dependencies;
+    }
+    ThreadPool pool(threads);
+    // Dependents are submitted before the finished task leaves the pool, so wait() can not return early
+    std::function<void(TaskId)> submit = [&](TaskId id) {
+        pool.submit([&, id] {
+            nodes[id].task();
+            for (TaskId dependent : nodes[id].dependents) {
+                if (--remaining[dependent] == 0) {
+                    submit(dependent);
+                }
+            }
+        });
+    };
+    for (TaskId id = 0; id < nodes.size(); ++id) {
+        if (nodes[id].dependencies == 0) {
+            submit(id);
+        }
+    }
+    pool.wait();
+}
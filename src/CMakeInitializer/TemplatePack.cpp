@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/format.hpp>
+#include <CMakeInitializer/TemplatePack.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/Hash.h>
+
+namespace fs = std::filesystem;
+
+// Cache layout (native byte order, it never leaves the machine):
+//   magic, u64 signature, u32 file count, then for every file
+//   u8 executable, path segments, content segments.
+// Segments: u32 count, then u8 kind followed by u32 length and bytes for text or u8 variable index.
+static const char cache_magic[8] = {'C', 'M', 'I', 'T', 'P', 'L', '0', '1'};
+
+enum SegmentKind : uint8_t { Text, Placeholder };
+
+static const std::array<const char*, TemplatePack::VariableCount> variable_names = {
+    "project_name", "language", "standard", "cmake_version", "file_extension"
+};
+
+TemplatePack::TemplatePack(const fs::path& directory) : directory(fs::absolute(directory)) {
+    if (!fs::is_directory(this->directory)) {
+        throw LogicException("template pack must be a directory");
+    }
+    const char* cache_home = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    fs::path cache_dir = cache_home ? fs::path(cache_home)
+        : home ? fs::path(home) / ".cache"
+        : fs::temp_directory_path();
+    cache_path = cache_dir / "cmake-init"
+        / (boost::format("templates-%016x.bin") % fnv1a(this->directory.string())).str();
+
+    std::vector<fs::path> files = template_files();
+    uint64_t pack_signature = signature(files);
+    if (!map_cache(pack_signature)) {
+        build_cache(files, pack_signature);
+        if (!map_cache(pack_signature)) {
+            throw LogicException("template pack cache can not be loaded");
+        }
+    }
+}
+
+TemplatePack::~TemplatePack() {
+    unmap_cache();
+}
+
+std::vector<fs::path> TemplatePack::template_files() const {
+    std::vector<fs::path> files;
+    for (auto it = fs::recursive_directory_iterator(directory); it != fs::recursive_directory_iterator(); ++it) {
+        if (it->is_directory() && it->path().filename() == ".git") {
+            it.disable_recursion_pending();
+        } else if (it->is_regular_file()) {
+            files.push_back(it->path().lexically_relative(directory));
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Cheap validity check of cached form: names, sizes and modification times of pack files
+uint64_t TemplatePack::signature(const std::vector<fs::path>& files) const {
+    uint64_t hash = fnv1a(std::string_view(cache_magic, sizeof(cache_magic)));
+    for (const fs::path& file : files) {
+        struct stat info = {};
+        stat((directory / file).c_str(), &info);
+        hash = fnv1a(file.string(), hash);
+        hash = fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_size), sizeof(info.st_size)), hash);
+        hash = fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_mtim), sizeof(info.st_mtim)), hash);
+        hash = fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_mode), sizeof(info.st_mode)), hash);
+    }
+    return hash;
+}
+
+template <typename T>
+static void write_value(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write_segments(std::string& out, std::string_view text) {
+    std::string segments;
+    uint32_t count = 0;
+    auto add_text = [&](std::string_view part) {
+        if (part.empty()) {
+            return;
+        }
+        write_value<uint8_t>(segments, Text);
+        write_value<uint32_t>(segments, part.size());
+        segments.append(part);
+        ++count;
+    };
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t open = text.find("{{", position);
+        size_t close = open == std::string_view::npos ? open : text.find("}}", open + 2);
+        if (close == std::string_view::npos) {
+            break;
+        }
+        std::string_view name = text.substr(open + 2, close - open - 2);
+        while (!name.empty() && name.front() == ' ') {
+            name.remove_prefix(1);
+        }
+        while (!name.empty() && name.back() == ' ') {
+            name.remove_suffix(1);
+        }
+        auto variable = std::find(variable_names.begin(), variable_names.end(), name);
+        if (variable == variable_names.end()) {
+            // Unknown placeholders are kept as is
+            add_text(text.substr(position, close + 2 - position));
+        } else {
+            add_text(text.substr(position, open - position));
+            write_value<uint8_t>(segments, Placeholder);
+            write_value<uint8_t>(segments, variable - variable_names.begin());
+            ++count;
+        }
+        position = close + 2;
+    }
+    add_text(text.substr(position));
+    write_value<uint32_t>(out, count);
+    out += segments;
+}
+
+void TemplatePack::build_cache(const std::vector<fs::path>& files, uint64_t signature) const {
+    std::string out(cache_magic, sizeof(cache_magic));
+    write_value<uint64_t>(out, signature);
+    write_value<uint32_t>(out, files.size());
+    for (const fs::path& file : files) {
+        std::ifstream input(directory / file, std::ios::binary);
+        std::stringstream content;
+        content << input.rdbuf();
+        fs::perms permissions = fs::status(directory / file).permissions();
+        write_value<uint8_t>(out, (permissions & fs::perms::owner_exec) != fs::perms::none);
+        write_segments(out, file.string());
+        write_segments(out, content.str());
+    }
+    // Written aside and renamed, so concurrent runs never map a half-written cache
+    fs::create_directories(cache_path.parent_path());
+    fs::path temporary = cache_path;
+    temporary += "." + std::to_string(getpid());
+    std::ofstream(temporary, std::ios::binary) << out;
+    fs::rename(temporary, cache_path);
+}
+
+namespace {
+
+class CacheReader {
+private:
+    const char* ptr;
+    const char* end;
+public:
+    CacheReader(const char* data, size_t size) : ptr(data), end(data + size) {}
+
+    bool at_end() const {
+        return ptr == end;
+    }
+
+    std::string_view read_bytes(size_t count) {
+        if (static_cast<size_t>(end - ptr) < count) {
+            throw std::out_of_range("truncated template cache");
+        }
+        std::string_view bytes(ptr, count);
+        ptr += count;
+        return bytes;
+    }
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, read_bytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    // Appends rendered segments to out when values are given, only validates otherwise
+    void read_segments(const TemplatePack::Values* values, std::string* out) {
+        uint32_t count = read<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint8_t kind = read<uint8_t>();
+            if (kind == Text) {
+                std::string_view text = read_bytes(read<uint32_t>());
+                if (out) {
+                    out->append(text);
+                }
+            } else if (kind == Placeholder) {
+                uint8_t variable = read<uint8_t>();
+                if (variable >= TemplatePack::VariableCount) {
+                    throw std::out_of_range("unknown template variable");
+                }
+                if (out) {
+                    out->append((*values)[variable]);
+                }
+            } else {
+                throw std::out_of_range("unknown template segment");
+            }
+        }
+    }
+};
+
+}
+
+static std::vector<TemplatePack::RenderedFile> read_cache(const char* data, size_t size,
+        const TemplatePack::Values* values) {
+    CacheReader reader(data, size);
+    reader.read_bytes(sizeof(cache_magic));
+    reader.read<uint64_t>();
+    uint32_t count = reader.read<uint32_t>();
+    std::vector<TemplatePack::RenderedFile> files;
+    for (uint32_t i = 0; i < count; ++i) {
+        TemplatePack::RenderedFile file;
+        file.executable = reader.read<uint8_t>() != 0;
+        reader.read_segments(values, values ? &file.path : nullptr);
+        reader.read_segments(values, values ? &file.content : nullptr);
+        if (values) {
+            files.push_back(std::move(file));
+        }
+    }
+    if (!reader.at_end()) {
+        throw std::out_of_range("trailing bytes in template cache");
+    }
+    return files;
+}
+
+bool TemplatePack::map_cache(uint64_t signature) {
+    unmap_cache();
+    int fd = open(cache_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(cache_magic) + sizeof(uint64_t)) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    cache = static_cast<const char*>(data);
+    cache_size = info.st_size;
+    uint64_t cached_signature;
+    std::memcpy(&cached_signature, cache + sizeof(cache_magic), sizeof(uint64_t));
+    if (std::memcmp(cache, cache_magic, sizeof(cache_magic)) != 0 || cached_signature != signature) {
+        unmap_cache();
+        return false;
+    }
+    try {
+        read_cache(cache, cache_size, nullptr);
+    } catch (std::out_of_range&) {
+        unmap_cache();
+        return false;
+    }
+    return true;
+}
+
+void TemplatePack::unmap_cache() {
+    if (cache) {
+        munmap(const_cast<char*>(cache), cache_size);
+        cache = nullptr;
+        cache_size = 0;
+    }
+}
+
+std::vector<TemplatePack::RenderedFile> TemplatePack::render(const Values& values) const {
+    return read_cache(cache, cache_size, &values);
+}
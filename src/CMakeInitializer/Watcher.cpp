@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <regex>
+#include <system_error>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string.hpp>
+#include <CMakeInitializer/Watcher.h>
+#include <CMakeInitializer/Errors.h>
+#include <CMakeInitializer/Process.h>
+#include <CMakeInitializer/AffectedTests.h>
+
+namespace options = boost::program_options;
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+static const std::array<const char*, 4> watched_folders = {"src", "include", "app", "test"};
+static const uint32_t watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static options::options_description get_description();
+
+static void on_interrupt(int) {
+    interrupted = 1;
+}
+
+static bool is_tracked_file(const fs::path& path) {
+    static const std::set<std::string> extensions = {
+        ".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx", ".cppm", ".ixx", ".cmake"
+    };
+    return path.filename() == "CMakeLists.txt" || extensions.count(path.extension().string());
+}
+
+static bool is_multi_config(const fs::path& presets_file) {
+    std::ifstream file(presets_file);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return content.find("\"Ninja Multi-Config\"") != std::string::npos;
+}
+
+// Configuration of profile from "configuration" of its build preset (cmake-pm reads it the same way),
+// presets without one are expected to be named after their configuration
+static std::string config_of(const fs::path& project_dir, const std::string& profile) {
+    static const std::regex configuration_regex(R""""("configuration":"([^"]*)")"""");
+    for (const char* presets_file : {"CMakePresets.json", "CMakeUserPresets.json"}) {
+        std::ifstream file(project_dir / presets_file);
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        content.erase(std::remove_if(content.begin(), content.end(), [](char c) { return std::isspace(c); }),
+            content.end());
+        std::vector<std::string> objects;
+        boost::split(objects, content, boost::is_any_of("}"));
+        std::smatch match;
+        for (const std::string& object : objects) {
+            if (object.find("\"name\":\"" + profile + "\"") != std::string::npos
+                    && std::regex_search(object, match, configuration_regex)) {
+                return match[1];
+            }
+        }
+    }
+    return profile;
+}
+
+Watcher::Watcher(int argc, char* argv[]) {
+    options::options_description desc = get_description();
+    options::positional_options_description positional;
+    positional.add("args", -1);
+    options::variables_map map;
+    options::store(options::command_line_parser(argc, argv).options(desc).positional(positional).run(), map);
+    options::notify(map);
+    if (map.count("help")) {
+        std::cout << desc << "\n";
+        throw ExitSignal();
+    }
+    project_dir = fs::absolute(map["dir"].as<std::string>());
+    mode = map["mode"].as<std::string>();
+    // Any configure preset is a valid mode, projects without presets know only the two build types
+    presets = fs::exists(project_dir / "CMakePresets.json");
+    if (!presets) {
+        boost::to_lower(mode);
+        if (mode != "release" && mode != "debug") {
+            throw LogicException("watch mode must be release or debug");
+        }
+    }
+    build_dir = project_dir / ".build" / mode;
+    if (presets && is_multi_config(project_dir / "CMakePresets.json")) {
+        build_dir = project_dir / ".build";
+        config = config_of(project_dir, mode);
+    }
+    run_tests = map.count("tests") > 0;
+    debounce = std::chrono::milliseconds(map["debounce"].as<int>());
+    if (map.count("args")) {
+        app_arguments = map["args"].as<std::vector<std::string>>();
+    }
+    if (!fs::exists(project_dir / "CMakeLists.txt")) {
+        throw LogicException("watch must be started in a project directory");
+    }
+}
+
+Watcher::~Watcher() {
+    cancel_job();
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+}
+
+static options::options_description get_description() {
+    options::options_description desc("Rebuild and rerun project on source changes");
+    desc.add_options()
+        ("help,h", "Help")
+        ("dir,d", options::value<std::string>()->default_value("."), "Project directory")
+        ("mode,m", options::value<std::string>()->default_value("debug"), "Build mode (debug, release or preset name)")
+        ("tests,t", "Rerun tests instead of the app")
+        ("debounce", options::value<int>()->default_value(200), "Quiet period before rebuild, ms")
+        ("args", options::value<std::vector<std::string>>(), "Arguments passed to the app");
+    return desc;
+}
+
+// Files already inside directory created while watching (newlib, mkdir -p && write, git checkout) count as changed,
+// directories removed before they are watched (temporary ones) are skipped
+void Watcher::add_watch_recursive(const fs::path& directory, bool created) {
+    int wd = inotify_add_watch(inotify_fd, directory.c_str(), watch_mask);
+    if (wd < 0) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+            return;
+        }
+        throw std::system_error(errno, std::generic_category(), "inotify_add_watch " + directory.string());
+    }
+    watches[wd] = directory;
+    std::error_code error;
+    for (fs::directory_iterator entry(directory, error), end; !error && entry != end; entry.increment(error)) {
+        std::error_code type_error;
+        if (entry->is_directory(type_error)) {
+            add_watch_recursive(entry->path(), created);
+        } else if (is_tracked_file(entry->path())) {
+            (created ? changed_files : known_files).insert(entry->path());
+        }
+    }
+}
+
+// Watches of existing directories are kept, so it also rescans tree after overflow
+void Watcher::add_watched_folders() {
+    for (const char* folder : watched_folders) {
+        if (fs::is_directory(project_dir / folder)) {
+            add_watch_recursive(project_dir / folder, false);
+        }
+    }
+}
+
+// Returns true if at least one tracked file was touched
+bool Watcher::read_events() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    bool touched = false;
+    while (true) {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflowed = true;
+                touched = true;
+                continue;
+            }
+            auto watch = watches.find(event->wd);
+            if (watch == watches.end() || event->len == 0) {
+                continue;
+            }
+            fs::path path = watch->second / event->name;
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                add_watch_recursive(path, true);
+                touched = true;
+            } else if (is_tracked_file(path)) {
+                changed_files.insert(path);
+                touched = true;
+            }
+        }
+    }
+    return touched;
+}
+
+// Globbed CMake lists only pick up added or removed files after reconfiguration.
+// Events lost in queue overflow make everything suspect: tree is rescanned, reconfigured and all tests run.
+bool Watcher::structure_changed() {
+    if (overflowed) {
+        std::cout << "Event queue overflowed, reconfiguring and running all tests\n";
+        overflowed = false;
+        changed_files.clear();
+        untested_files.clear();
+        known_files.clear();
+        tested_once = false;
+        add_watched_folders();
+        return true;
+    }
+    bool changed = false;
+    for (const fs::path& path : changed_files) {
+        untested_files.insert(path);
+        bool exists = fs::exists(path);
+        bool known = known_files.count(path) > 0;
+        if (exists && !known) {
+            known_files.insert(path);
+            changed = true;
+        } else if (!exists && known) {
+            known_files.erase(path);
+            changed = true;
+        }
+        if (path.filename() == "CMakeLists.txt" || path.extension() == ".cmake") {
+            changed = true;
+        }
+    }
+    changed_files.clear();
+    return changed;
+}
+
+static std::string read_project_name(const fs::path& build_dir) {
+    std::ifstream cache(build_dir / "CMakeCache.txt");
+    const std::string key = "CMAKE_PROJECT_NAME:STATIC=";
+    std::string line;
+    while (std::getline(cache, line)) {
+        if (boost::starts_with(line, key)) {
+            return line.substr(key.size());
+        }
+    }
+    return "";
+}
+
+std::vector<std::string> Watcher::run_command() const {
+    if (run_tests) {
+        std::vector<std::string> command = {"ctest", "--test-dir", build_dir.string(), "--output-on-failure"};
+        if (!config.empty()) {
+            command.insert(command.end(), {"-C", config});
+        }
+        if (tested_once) {
+            AffectedTests affected = AffectedTests(project_dir, build_dir);
+            std::string filter = affected.test_filter({untested_files.begin(), untested_files.end()});
+            if (filter.empty()) {
+                std::cout << "No tests affected by changes\n";
+                return {};
+            }
+            command.insert(command.end(), {"-R", filter});
+        }
+        return command;
+    }
+    std::vector<std::string> command = {
+        (build_dir / "app" / config / (read_project_name(build_dir) + "-app")).lexically_normal().string()
+    };
+    command.insert(command.end(), app_arguments.begin(), app_arguments.end());
+    return command;
+}
+
+void Watcher::start_pipeline(bool reconfigure) {
+    pipeline.clear();
+    if (reconfigure || !fs::exists(build_dir / "CMakeCache.txt")) {
+        if (presets) {
+            pipeline.push_back({"cmake", "-S", project_dir.string(), "--preset", mode});
+        } else {
+            pipeline.push_back({"cmake", "-S", project_dir.string(), "-B", build_dir.string(),
+                "-DCMAKE_BUILD_TYPE=" + boost::to_upper_copy(mode), "-G", "Ninja"});
+        }
+    }
+    std::vector<std::string> build = {"cmake", "--build", build_dir.string()};
+    if (!config.empty()) {
+        build.insert(build.end(), {"--config", config});
+    }
+    if (run_tests) {
+        build.insert(build.end(), {"--target", "tests"});
+    }
+    pipeline.push_back(build);
+    // Run step is resolved lazily: project name is only known after configuration
+    pipeline.push_back({});
+    start_next_job();
+}
+
+void Watcher::start_next_job() {
+    if (pipeline.empty()) {
+        return;
+    }
+    std::vector<std::string> command = pipeline.front().empty() ? run_command() : pipeline.front();
+    pipeline.erase(pipeline.begin());
+    if (command.empty()) {
+        return;
+    }
+    current_job = process::spawn(command, project_dir.string());
+}
+
+void Watcher::cancel_job() {
+    if (current_job > 0) {
+        process::terminate(current_job);
+        current_job = -1;
+    }
+    pipeline.clear();
+}
+
+void Watcher::run() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    }
+    add_watched_folders();
+    struct sigaction action = {};
+    action.sa_handler = on_interrupt;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << boost::format("Watching %1% (%2%), press Ctrl+C to stop\n") % project_dir.string() % mode;
+    start_pipeline(false);
+
+    bool pending = false;
+    clock_type::time_point last_change;
+    while (!interrupted) {
+        int timeout = -1;
+        if (pending) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                last_change + debounce - clock_type::now());
+            timeout = std::max<int>(0, left.count());
+        } else if (current_job > 0) {
+            timeout = 50;
+        }
+        pollfd fd = {inotify_fd, POLLIN, 0};
+        int ready = poll(&fd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        if (ready > 0 && read_events()) {
+            if (current_job > 0) {
+                std::cout << "Change detected, cancelling current job\n";
+            }
+            cancel_job();
+            pending = true;
+            last_change = clock_type::now();
+        }
+        if (pending && clock_type::now() >= last_change + debounce) {
+            pending = false;
+            std::cout << "Change detected, rebuilding\n";
+            start_pipeline(structure_changed());
+        }
+        int exit_code = 0;
+        if (current_job > 0 && process::poll_exit(current_job, exit_code)) {
+            current_job = -1;
+            if (pipeline.empty() && run_tests) {
+                // Failed tests are reported by ctest, changes count as tested either way
+                untested_files.clear();
+                tested_once = true;
+            }
+            if (exit_code == 0) {
+                start_next_job();
+                if (current_job < 0) {
+                    std::cout << "Done, waiting for changes\n";
+                }
+            } else {
+                pipeline.clear();
+                std::cout << boost::format("Job failed with code %1%, waiting for changes\n") % exit_code;
+            }
+        }
+    }
+    cancel_job();
+}
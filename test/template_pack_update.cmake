@@ -0,0 +1,35 @@
+# Update with template pack keeps user edited files the pack replaces (app/app.cpp) or adds (pack-only file),
+# and still updates generated files the pack replaces (scripts/macros.cmake)
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(WRITE "${WORK_DIR}/pack/app/app.cpp" "int main() { return 1; }\n")
+file(WRITE "${WORK_DIR}/pack/docs/notes.md" "pack notes\n")
+file(WRITE "${WORK_DIR}/pack/scripts/macros.cmake" "# pack macros, version 1\n")
+
+function(run_cmake_init)
+    execute_process(COMMAND "${CMAKE_INIT}" ${ARGN}
+        WORKING_DIRECTORY "${WORK_DIR}"
+        RESULT_VARIABLE RESULT
+        OUTPUT_QUIET)
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "cmake-init ${ARGN} failed: ${RESULT}")
+    endif()
+endfunction()
+
+function(expect_content FILE EXPECTED)
+    file(READ "${WORK_DIR}/project/${FILE}" CONTENT)
+    if(NOT CONTENT STREQUAL EXPECTED)
+        message(FATAL_ERROR "${FILE} is\n${CONTENT}\nexpected\n${EXPECTED}")
+    endif()
+endfunction()
+
+run_cmake_init(-n project -q -t pack)
+expect_content(app/app.cpp "int main() { return 1; }\n")
+
+file(WRITE "${WORK_DIR}/project/app/app.cpp" "int main() { return 2; }\n")
+file(WRITE "${WORK_DIR}/project/docs/notes.md" "user notes\n")
+file(WRITE "${WORK_DIR}/pack/scripts/macros.cmake" "# pack macros, version 2\n")
+run_cmake_init(-n project -q -u -t pack)
+expect_content(app/app.cpp "int main() { return 2; }\n")
+expect_content(docs/notes.md "user notes\n")
+expect_content(scripts/macros.cmake "# pack macros, version 2\n")